@@ -0,0 +1,495 @@
+#include "aggregation.h"
+#include "columns.h"
+#include "follow.h"
+#include "parallel.h"
+#include "sketches.h"
+#include "stats_engine.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Rows per chunk; each chunk aggregates into its own table
+const size_t AGGREGATE_GRAIN = 16384;
+const uint32_t EMPTY_SLOT = numeric_limits<uint32_t>::max();
+// Rows per pivot chunk, and the grid size above which the pivot keeps a
+// single grid instead of one per chunk
+const size_t PIVOT_GRAIN = 32768;
+const size_t PIVOT_PARTIAL_CELLS = 1 << 20;
+
+// Open-addressing slot: the hash sits next to the group id so most probes
+// are resolved without touching the key strings
+struct Slot {
+    uint64_t hash;
+    uint32_t group;
+};
+
+// Hash table from group key to dense group id, with the aggregate state of
+// every group stored in flat arrays indexed by that id
+class GroupTable {
+public:
+    GroupTable(const vector<size_t>& keys, size_t value_width, size_t distinct_width)
+        : keys_(keys), value_width_(value_width), distinct_width_(distinct_width),
+          slots_(64, Slot{0, EMPTY_SLOT}), mask_(63) {}
+
+    size_t groups() const { return first_row.size(); }
+
+    size_t find_or_insert(uint64_t hash, size_t row) {
+        if ((groups() + 1) * 4 > slots_.size() * 3) grow();
+        for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+            Slot& slot = slots_[i];
+            if (slot.group == EMPTY_SLOT) {
+                slot.hash = hash;
+                slot.group = static_cast<uint32_t>(groups());
+                first_row.push_back(row);
+                hashes.push_back(hash);
+                counts.push_back(0);
+                stats.resize(stats.size() + value_width_);
+                sums.resize(sums.size() + value_width_, 0.0);
+                distinct.resize(distinct.size() + distinct_width_);
+                return slot.group;
+            }
+            if (slot.hash == hash && same_key(first_row[slot.group], row)) return slot.group;
+        }
+    }
+
+    // Folds a table built over later rows into this one
+    void merge(const GroupTable& other) {
+        for (size_t g = 0; g < other.groups(); ++g) {
+            size_t id = find_or_insert(other.hashes[g], other.first_row[g]);
+            counts[id] += other.counts[g];
+            for (size_t v = 0; v < value_width_; ++v) {
+                stats[id * value_width_ + v].merge(other.stats[g * value_width_ + v]);
+                sums[id * value_width_ + v] += other.sums[g * value_width_ + v];
+            }
+            for (size_t d = 0; d < distinct_width_; ++d) {
+                const unordered_set<uint64_t>& values = other.distinct[g * distinct_width_ + d];
+                distinct[id * distinct_width_ + d].insert(values.begin(), values.end());
+            }
+        }
+    }
+
+    vector<size_t> first_row;    // data row that introduced each group
+    vector<uint64_t> hashes;
+    vector<size_t> counts;
+    vector<RunningStats> stats;  // groups x value columns
+    vector<double> sums;
+    vector<unordered_set<uint64_t>> distinct;  // groups x distinct columns, value hashes
+
+private:
+    bool same_key(size_t a, size_t b) const {
+        for (size_t k = 0; k < keys_.size(); ++k) {
+            if (dataset[a + 1].data[keys_[k]] != dataset[b + 1].data[keys_[k]]) return false;
+        }
+        return true;
+    }
+
+    void grow() {
+        vector<Slot> slots(slots_.size() * 2, Slot{0, EMPTY_SLOT});
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].group == EMPTY_SLOT) continue;
+            size_t j = slots_[i].hash & mask;
+            while (slots[j].group != EMPTY_SLOT) j = (j + 1) & mask;
+            slots[j] = slots_[i];
+        }
+        slots_.swap(slots);
+        mask_ = mask;
+    }
+
+    const vector<size_t>& keys_;
+    size_t value_width_;
+    size_t distinct_width_;
+    vector<Slot> slots_;
+    size_t mask_;
+};
+
+// Groups of one hash_aggregate call kept for the next one with the same
+// keys and aggregates, which then only folds in the rows appended since
+struct MaintainedGroups : MaintainedState {
+    vector<size_t> keys;   // the table refers to these
+    RowWatermark seen;
+    unique_ptr<GroupTable> table;
+};
+
+uint64_t key_hash(size_t row, const vector<size_t>& keys) {
+    uint64_t hash = 0;
+    for (size_t k = 0; k < keys.size(); ++k) {
+        hash = (hash * 0x100000001B3ULL) ^ hash_string(dataset[row + 1].data[keys[k]]);
+    }
+    return hash;
+}
+
+// Position of col in cols, appending it when missing
+size_t slot_of(vector<size_t>& cols, size_t col) {
+    for (size_t i = 0; i < cols.size(); ++i) {
+        if (cols[i] == col) return i;
+    }
+    cols.push_back(col);
+    return cols.size() - 1;
+}
+
+// Columns each kind of state is kept for, and where each aggregate reads
+struct StateLayout {
+    vector<size_t> value_cols, distinct_cols, state;
+};
+
+StateLayout layout_of(const vector<AggregateSpec>& aggregates) {
+    StateLayout layout;
+    layout.state.assign(aggregates.size(), 0);
+    for (size_t a = 0; a < aggregates.size(); ++a) {
+        if (aggregates[a].kind == AGG_COUNT) continue;
+        layout.state[a] = aggregates[a].kind == AGG_DISTINCT ? slot_of(layout.distinct_cols, aggregates[a].column)
+                                                             : slot_of(layout.value_cols, aggregates[a].column);
+    }
+    return layout;
+}
+
+// Cell of one aggregate for a group; numeric aggregates of a group without
+// values are left empty
+string aggregate_cell(AggregateKind kind, size_t count, const RunningStats& stats, double sum, size_t distinct) {
+    if (kind == AGG_COUNT) return to_string(count);
+    if (kind == AGG_DISTINCT) return to_string(distinct);
+    if (stats.count == 0) return "";
+    double value = kind == AGG_SUM ? sum
+                 : kind == AGG_MEAN ? stats.mean
+                 : kind == AGG_MIN ? stats.min
+                 : kind == AGG_MAX ? stats.max
+                 : stats.variance();
+    return format_number(value);
+}
+
+// Aggregate state of numbered buckets in flat arrays, laid out like GroupTable
+struct BucketStates {
+    BucketStates(const StateLayout& layout, const vector<const double*>& values)
+        : layout(layout), values(values) {}
+
+    void resize(size_t buckets) {
+        counts.resize(buckets, 0);
+        stats.resize(buckets * layout.value_cols.size());
+        sums.resize(buckets * layout.value_cols.size(), 0.0);
+        distinct.resize(buckets * layout.distinct_cols.size());
+    }
+
+    void add(size_t b, size_t row) {
+        const size_t width = layout.value_cols.size(), distinct_width = layout.distinct_cols.size();
+        counts[b]++;
+        for (size_t v = 0; v < width; ++v) {
+            double x = values[v][row];
+            if (x != x) continue;
+            stats[b * width + v].add(x);
+            sums[b * width + v] += x;
+        }
+        for (size_t d = 0; d < distinct_width; ++d) {
+            const string& cell = dataset[row + 1].data[layout.distinct_cols[d]];
+            if (!is_null_value(cell)) distinct[b * distinct_width + d].insert(hash_string(cell));
+        }
+    }
+
+    void merge(size_t b, const BucketStates& other, size_t from) {
+        const size_t width = layout.value_cols.size(), distinct_width = layout.distinct_cols.size();
+        counts[b] += other.counts[from];
+        for (size_t v = 0; v < width; ++v) {
+            stats[b * width + v].merge(other.stats[from * width + v]);
+            sums[b * width + v] += other.sums[from * width + v];
+        }
+        for (size_t d = 0; d < distinct_width; ++d) {
+            const unordered_set<uint64_t>& set = other.distinct[from * distinct_width + d];
+            distinct[b * distinct_width + d].insert(set.begin(), set.end());
+        }
+    }
+
+    const StateLayout& layout;
+    const vector<const double*>& values;
+    vector<size_t> counts;
+    vector<RunningStats> stats;
+    vector<double> sums;
+    vector<unordered_set<uint64_t>> distinct;
+};
+
+} // namespace
+
+bool find_aggregate(const string& name, AggregateKind& kind) {
+    static const map<string, AggregateKind> kinds = {
+        {"count", AGG_COUNT}, {"sum", AGG_SUM}, {"mean", AGG_MEAN}, {"avg", AGG_MEAN}, {"min", AGG_MIN},
+        {"max", AGG_MAX}, {"variance", AGG_VARIANCE}, {"distinct", AGG_DISTINCT}};
+    auto found = kinds.find(name);
+    if (found == kinds.end()) return false;
+    kind = found->second;
+    return true;
+}
+
+bool parse_aggregates(const string& spec, vector<AggregateSpec>& aggregates, string& error) {
+    aggregates.clear();
+    vector<string> items = split_list(spec);
+    for (size_t i = 0; i < items.size(); ++i) {
+        const string& item = items[i];
+        if (item == "count") {
+            aggregates.push_back(AggregateSpec{AGG_COUNT, 0, "count"});
+            continue;
+        }
+
+        size_t open = item.find('(');
+        if (open == string::npos || item.back() != ')') {
+            error = "Invalid aggregate: " + item;
+            return false;
+        }
+        string kind = item.substr(0, open);
+        kind.erase(kind.find_last_not_of(" \t") + 1);
+        vector<string> inner = split_list(item.substr(open + 1, item.size() - open - 2));
+        string column = inner.size() == 1 ? inner[0] : "";
+
+        AggregateKind found;
+        if (!find_aggregate(kind, found) || found == AGG_COUNT) {
+            error = "Unknown aggregate: " + kind;
+            return false;
+        }
+        int index = find_column(column);
+        if (index == -1) {
+            error = "Column not found: " + column;
+            return false;
+        }
+        if (found != AGG_DISTINCT && !is_numeric_column(index)) {
+            error = "Column " + column + " is not numeric";
+            return false;
+        }
+        aggregates.push_back(AggregateSpec{found, static_cast<size_t>(index), kind + "_" + column});
+    }
+
+    if (aggregates.empty()) {
+        error = "No aggregates given";
+        return false;
+    }
+    return true;
+}
+
+vector<CSVRow> hash_aggregate(const vector<size_t>& keys, const vector<AggregateSpec>& aggregates) {
+    const StateLayout layout = layout_of(aggregates);
+    const vector<size_t>& value_cols = layout.value_cols;
+    const vector<size_t>& distinct_cols = layout.distinct_cols;
+    const vector<size_t>& state = layout.state;
+    vector<const double*> values;
+    for (size_t v = 0; v < value_cols.size(); ++v) values.push_back(numeric_column(value_cols[v]).values.data());
+
+    const size_t rows = dataset.size() - 1;
+    const size_t width = value_cols.size(), distinct_width = distinct_cols.size();
+
+    string signature = "hash_aggregate/";
+    for (size_t k = 0; k < keys.size(); ++k) signature += to_string(keys[k]) + ",";
+    for (size_t a = 0; a < aggregates.size(); ++a) {
+        signature += ";" + to_string(aggregates[a].kind) + ":" + to_string(aggregates[a].column);
+    }
+    MaintainedGroups fresh;
+    MaintainedGroups* entry = maintained_state<MaintainedGroups>(signature);
+    if (!entry) entry = &fresh;
+    if (!entry->table) entry->keys = keys;
+    vector<size_t> read(keys);
+    read.insert(read.end(), value_cols.begin(), value_cols.end());
+    read.insert(read.end(), distinct_cols.begin(), distinct_cols.end());
+    const size_t first = entry->seen.covered(read);
+    if (first == 0) entry->table.reset(new GroupTable(entry->keys, width, distinct_width));
+
+    vector<unique_ptr<GroupTable>> partial(chunk_count(rows - first, AGGREGATE_GRAIN));
+    parallel_for(rows - first, AGGREGATE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        partial[chunk].reset(new GroupTable(keys, width, distinct_width));
+        GroupTable& table = *partial[chunk];
+        for (size_t row = first + begin; row < first + end; ++row) {
+            size_t g = table.find_or_insert(key_hash(row, keys), row);
+            table.counts[g]++;
+            for (size_t v = 0; v < width; ++v) {
+                double x = values[v][row];
+                if (x != x) continue;
+                table.stats[g * width + v].add(x);
+                table.sums[g * width + v] += x;
+            }
+            for (size_t d = 0; d < distinct_width; ++d) {
+                const string& cell = dataset[row + 1].data[distinct_cols[d]];
+                if (!is_null_value(cell)) table.distinct[g * distinct_width + d].insert(hash_string(cell));
+            }
+        }
+    });
+
+    // Chunks cover increasing row ranges after the rows already held, so
+    // merging in order keeps each group's first row the earliest one
+    GroupTable& total = *entry->table;
+    for (size_t chunk = 0; chunk < partial.size(); ++chunk) {
+        total.merge(*partial[chunk]);
+        partial[chunk].reset();
+    }
+    entry->seen.advance(read);
+
+    vector<size_t> order(total.groups());
+    for (size_t g = 0; g < order.size(); ++g) order[g] = g;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        for (size_t k = 0; k < keys.size(); ++k) {
+            const string& x = dataset[total.first_row[a] + 1].data[keys[k]];
+            const string& y = dataset[total.first_row[b] + 1].data[keys[k]];
+            if (x != y) return x < y;
+        }
+        return false;
+    });
+
+    vector<CSVRow> result(order.size() + 1);
+    for (size_t k = 0; k < keys.size(); ++k) result[0].data.push_back(dataset[0].data[keys[k]]);
+    for (size_t a = 0; a < aggregates.size(); ++a) result[0].data.push_back(aggregates[a].name);
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        size_t g = order[i];
+        vector<string>& out = result[i + 1].data;
+        for (size_t k = 0; k < keys.size(); ++k) out.push_back(dataset[total.first_row[g] + 1].data[keys[k]]);
+
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            const AggregateKind kind = aggregates[a].kind;
+            const bool numeric = kind != AGG_COUNT && kind != AGG_DISTINCT;
+            out.push_back(aggregate_cell(kind, total.counts[g],
+                                         numeric ? total.stats[g * width + state[a]] : RunningStats(),
+                                         numeric ? total.sums[g * width + state[a]] : 0.0,
+                                         kind == AGG_DISTINCT ? total.distinct[g * distinct_width + state[a]].size() : 0));
+        }
+    }
+    return result;
+}
+
+vector<CSVRow> bucket_aggregate(const vector<int64_t>& buckets, const string& label_name, const vector<string>& labels,
+                                const vector<AggregateSpec>& aggregates, bool& sorted) {
+    const StateLayout layout = layout_of(aggregates);
+    vector<const double*> values;
+    for (size_t v = 0; v < layout.value_cols.size(); ++v) values.push_back(numeric_column(layout.value_cols[v]).values.data());
+
+    BucketStates total(layout, values);
+    total.resize(labels.size());
+    const size_t rows = buckets.size();
+
+    int64_t last = -1;
+    sorted = true;
+    for (size_t row = 0; row < rows && sorted; ++row) {
+        if (buckets[row] < 0) continue;
+        sorted = buckets[row] >= last;
+        last = buckets[row];
+    }
+
+    if (sorted) {
+        // Each bucket is one run of rows: a single pass, no lookups
+        for (size_t row = 0; row < rows; ++row) {
+            if (buckets[row] >= 0) total.add(static_cast<size_t>(buckets[row]), row);
+        }
+    } else {
+        vector<unique_ptr<BucketStates>> partial(chunk_count(rows, AGGREGATE_GRAIN));
+        vector<unordered_map<int64_t, size_t>> local(partial.size());
+        parallel_for(rows, AGGREGATE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+            partial[chunk].reset(new BucketStates(layout, values));
+            BucketStates& states = *partial[chunk];
+            unordered_map<int64_t, size_t>& ids = local[chunk];
+            for (size_t row = begin; row < end; ++row) {
+                if (buckets[row] < 0) continue;
+                auto inserted = ids.insert(make_pair(buckets[row], ids.size()));
+                if (inserted.second) states.resize(ids.size());
+                states.add(inserted.first->second, row);
+            }
+        });
+        for (size_t chunk = 0; chunk < partial.size(); ++chunk) {
+            for (const auto& entry : local[chunk]) total.merge(static_cast<size_t>(entry.first), *partial[chunk], entry.second);
+            partial[chunk].reset();
+        }
+    }
+
+    const size_t width = layout.value_cols.size(), distinct_width = layout.distinct_cols.size();
+    vector<CSVRow> result(labels.size() + 1);
+    result[0].data.push_back(label_name);
+    for (size_t a = 0; a < aggregates.size(); ++a) result[0].data.push_back(aggregates[a].name);
+    for (size_t b = 0; b < labels.size(); ++b) {
+        vector<string>& out = result[b + 1].data;
+        out.push_back(labels[b]);
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            const AggregateKind kind = aggregates[a].kind;
+            const bool numeric = kind != AGG_COUNT && kind != AGG_DISTINCT;
+            out.push_back(aggregate_cell(kind, total.counts[b],
+                                         numeric ? total.stats[b * width + layout.state[a]] : RunningStats(),
+                                         numeric ? total.sums[b * width + layout.state[a]] : 0.0,
+                                         kind == AGG_DISTINCT ? total.distinct[b * distinct_width + layout.state[a]].size() : 0));
+        }
+    }
+    return result;
+}
+
+vector<CSVRow> dense_pivot(size_t row_col, size_t col_col, size_t value_col, AggregateKind kind) {
+    DictionaryColumn row_keys = dictionary_column(row_col);
+    DictionaryColumn col_keys = dictionary_column(col_col);
+    const size_t width = col_keys.values.size();
+    const size_t cells = row_keys.values.size() * width;
+
+    // Count works on any column, the other aggregates on its numeric values
+    const size_t rows = row_keys.ids.size();
+    vector<double> ones;
+    if (kind == AGG_COUNT) {
+        ones.assign(rows, numeric_limits<double>::quiet_NaN());
+        for (size_t row = 0; row < rows; ++row) {
+            if (!is_null_value(dataset[row + 1].data[value_col])) ones[row] = 1.0;
+        }
+    }
+    const double* values = kind == AGG_COUNT ? ones.data() : numeric_column(value_col).values.data();
+
+    const double start = kind == AGG_MIN ? numeric_limits<double>::infinity()
+                       : kind == AGG_MAX ? -numeric_limits<double>::infinity() : 0.0;
+    const size_t grain = cells > PIVOT_PARTIAL_CELLS ? max<size_t>(rows, 1) : PIVOT_GRAIN;
+    vector<vector<double>> acc(chunk_count(rows, grain));
+    vector<vector<size_t>> counts(acc.size());
+    parallel_for(rows, grain, [&](size_t chunk, size_t begin, size_t end) {
+        vector<double>& grid = acc[chunk];
+        vector<size_t>& n = counts[chunk];
+        grid.assign(cells, start);
+        n.assign(cells, 0);
+        for (size_t row = begin; row < end; ++row) {
+            double x = values[row];
+            if (x != x) continue;
+            size_t cell = static_cast<size_t>(row_keys.ids[row]) * width + col_keys.ids[row];
+            n[cell]++;
+            if (kind == AGG_MIN) {
+                grid[cell] = min(grid[cell], x);
+            } else if (kind == AGG_MAX) {
+                grid[cell] = max(grid[cell], x);
+            } else {
+                grid[cell] += x;
+            }
+        }
+    });
+    for (size_t chunk = 1; chunk < acc.size(); ++chunk) {
+        for (size_t cell = 0; cell < cells; ++cell) {
+            double x = acc[chunk][cell];
+            double& total = acc[0][cell];
+            total = kind == AGG_MIN ? min(total, x) : kind == AGG_MAX ? max(total, x) : total + x;
+            counts[0][cell] += counts[chunk][cell];
+        }
+    }
+
+    vector<size_t> row_order(row_keys.values.size()), col_order(width);
+    for (size_t i = 0; i < row_order.size(); ++i) row_order[i] = i;
+    for (size_t i = 0; i < col_order.size(); ++i) col_order[i] = i;
+    sort(row_order.begin(), row_order.end(), [&](size_t a, size_t b) { return row_keys.values[a] < row_keys.values[b]; });
+    sort(col_order.begin(), col_order.end(), [&](size_t a, size_t b) { return col_keys.values[a] < col_keys.values[b]; });
+
+    vector<CSVRow> result(row_order.size() + 1);
+    result[0].data.push_back(dataset[0].data[row_col]);
+    for (size_t c = 0; c < width; ++c) result[0].data.push_back(col_keys.values[col_order[c]]);
+    for (size_t r = 0; r < row_order.size(); ++r) {
+        vector<string>& out = result[r + 1].data;
+        out.push_back(row_keys.values[row_order[r]]);
+        for (size_t c = 0; c < width; ++c) {
+            size_t cell = row_order[r] * width + col_order[c];
+            size_t n = acc.empty() ? 0 : counts[0][cell];
+            double x = acc.empty() ? 0.0 : acc[0][cell];
+            if (kind == AGG_COUNT) {
+                out.push_back(to_string(n));
+            } else if (kind == AGG_SUM) {
+                out.push_back(format_number(x));   // empty cells sum to 0
+            } else if (n == 0) {
+                out.push_back("");
+            } else {
+                out.push_back(format_number(kind == AGG_MEAN ? x / n : x));
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef AGGREGATION_H
+#define AGGREGATION_H
+
+#include "main.h"
+#include <cstdint>
+
+enum AggregateKind { AGG_COUNT, AGG_SUM, AGG_MEAN, AGG_MIN, AGG_MAX, AGG_VARIANCE, AGG_DISTINCT };
+
+// One output column of a grouped table, e.g. mean(Sales) -> "mean_Sales"
+struct AggregateSpec {
+    AggregateKind kind;
+    size_t column;   // unused for count
+    string name;
+};
+
+// Looks up an aggregate by name (count, sum, mean/avg, min, max, variance, distinct)
+bool find_aggregate(const string& name, AggregateKind& kind);
+
+// Parses a list such as "count, sum(Sales), distinct(Customer)". Numeric
+// aggregates need numeric columns; distinct works on any column.
+bool parse_aggregates(const string& spec, vector<AggregateSpec>& aggregates, string& error);
+
+// Groups the dataset rows by the key columns with a parallel hash
+// aggregation and returns the grouped table (header first), sorted by key.
+// The group states are kept, so a repeated call after rows were appended
+// (follow mode) only aggregates the new rows.
+vector<CSVRow> hash_aggregate(const vector<size_t>& keys, const vector<AggregateSpec>& aggregates);
+
+// Aggregates the data rows into buckets 0 .. labels.size() - 1 (buckets[row],
+// or -1 to leave the row out) and returns one row per bucket, empty buckets
+// included, headed label_name and labels[b]. When the buckets never decrease
+// along the rows (time-sorted data) this is one sequential pass with no
+// lookups and sorted is set; otherwise each chunk aggregates into a hash map
+// of its buckets and the maps are merged.
+vector<CSVRow> bucket_aggregate(const vector<int64_t>& buckets, const string& label_name, const vector<string>& labels,
+                                const vector<AggregateSpec>& aggregates, bool& sorted);
+
+// Cross-tabulates value_col over the distinct values of row_col (rows) and
+// col_col (columns). Keys are mapped to dense ids and each chunk accumulates
+// into its own flat rows x columns grid before the grids are summed. Supports
+// count, sum, mean, min and max; returns the table with header first.
+vector<CSVRow> dense_pivot(size_t row_col, size_t col_col, size_t value_col, AggregateKind kind);
+
+#endif // AGGREGATION_H
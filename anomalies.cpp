@@ -0,0 +1,120 @@
+#include "anomalies.h"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Scales a median absolute deviation to a standard deviation for normal data
+const double MAD_SCALE = 1.4826;
+
+// Distance of x from center in units of spread; any difference counts as
+// infinitely far when there is no spread
+double standardized(double x, double center, double spread) {
+    if (spread > 0) return (x - center) / spread;
+    if (x == center) return 0.0;
+    return x > center ? numeric_limits<double>::infinity() : -numeric_limits<double>::infinity();
+}
+
+} // namespace
+
+bool find_anomaly_method(const string& name, AnomalyMethod& method) {
+    static const map<string, AnomalyMethod> methods = {
+        {"zscore", ANOMALY_ZSCORE}, {"ewma", ANOMALY_EWMA}, {"mad", ANOMALY_MAD}
+    };
+    auto it = methods.find(name);
+    if (it == methods.end()) return false;
+    method = it->second;
+    return true;
+}
+
+AnomalyDetector::AnomalyDetector(AnomalyMethod method, size_t window, double threshold)
+    : method(method), window(max<size_t>(window, 2)), threshold(threshold) {}
+
+bool AnomalyDetector::add(double x) {
+    score = count >= window ? evaluate(x) : 0.0;
+    count++;
+
+    if (method == ANOMALY_EWMA) {
+        if (count == 1) {
+            mean = x;
+        } else {
+            const double alpha = 2.0 / (window + 1.0);
+            double diff = x - mean, step = alpha * diff;
+            mean += step;
+            variance = (1 - alpha) * (variance + diff * step);
+        }
+    } else if (method == ANOMALY_ZSCORE) {
+        if (recent.empty()) shift = x;
+        recent.push_back(x);
+        sum += x - shift;
+        sum_sq += (x - shift) * (x - shift);
+        if (recent.size() > window) {
+            double d = recent.front() - shift;
+            recent.pop_front();
+            sum -= d;
+            sum_sq -= d * d;
+        }
+        // Re-add the sums once per window so subtraction error cannot build up
+        if (count % window == 0) {
+            shift = recent.front();
+            sum = sum_sq = 0.0;
+            for (double v : recent) {
+                sum += v - shift;
+                sum_sq += (v - shift) * (v - shift);
+            }
+        }
+    } else {
+        recent.push_back(x);
+        sorted.insert(upper_bound(sorted.begin(), sorted.end(), x), x);
+        if (recent.size() > window) {
+            sorted.erase(lower_bound(sorted.begin(), sorted.end(), recent.front()));
+            recent.pop_front();
+        }
+    }
+    return fabs(score) > threshold;
+}
+
+double AnomalyDetector::evaluate(double x) const {
+    switch (method) {
+        case ANOMALY_EWMA:
+            return standardized(x, mean, sqrt(variance));
+        case ANOMALY_ZSCORE: {
+            const double n = static_cast<double>(recent.size());
+            return standardized(x, shift + sum / n, sqrt(max(0.0, (sum_sq - sum * sum / n) / n)));
+        }
+        case ANOMALY_MAD: {
+            const size_t n = sorted.size();
+            double median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+            return standardized(x, median, MAD_SCALE * median_absolute_deviation(median));
+        }
+    }
+    return 0.0;
+}
+
+// Median of |v - median| over the sorted window without sorting the
+// deviations: those below the median ascend leftwards from it and those
+// above ascend rightwards, and the k-th smallest of two ascending sequences
+// is a binary search, O(log window)
+double AnomalyDetector::median_absolute_deviation(double median) const {
+    const size_t n = sorted.size();
+    const size_t split = lower_bound(sorted.begin(), sorted.end(), median) - sorted.begin();
+    const size_t below = split, above = n - split;
+    auto left = [&](size_t i) { return median - sorted[split - 1 - i]; };
+    auto right = [&](size_t j) { return sorted[split + j] - median; };
+
+    // The (k + 1) smallest deviations are the first i on the left and the
+    // first k + 1 - i on the right for the smallest i with left(i) >= right(k - i)
+    auto kth = [&](size_t k) {
+        size_t lo = k + 1 > above ? k + 1 - above : 0, hi = min(k + 1, below);
+        while (lo < hi) {
+            size_t i = (lo + hi) / 2;
+            if (left(i) < right(k - i)) lo = i + 1;
+            else hi = i;
+        }
+        double value = -numeric_limits<double>::infinity();
+        if (lo > 0) value = left(lo - 1);
+        if (k + 1 - lo > 0) value = max(value, right(k - lo));
+        return value;
+    };
+    return n % 2 ? kth(n / 2) : (kth(n / 2 - 1) + kth(n / 2)) / 2;
+}
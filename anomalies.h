@@ -0,0 +1,52 @@
+#ifndef ANOMALIES_H
+#define ANOMALIES_H
+
+#include "main.h"
+#include <deque>
+
+enum AnomalyMethod { ANOMALY_ZSCORE, ANOMALY_EWMA, ANOMALY_MAD };
+
+// Looks up a detector by name (zscore, ewma, mad)
+bool find_anomaly_method(const string& name, AnomalyMethod& method);
+
+// One-pass anomaly detector. Each value is scored against the values seen
+// before it and then added to the state, so a detector can be fed a series
+// piece by piece as it grows and give the same flags as one long run.
+//   zscore: distance from the mean of the last window values in standard
+//     deviations; running sums, O(1) per value
+//   ewma: distance from an exponentially weighted mean in exponentially
+//     weighted standard deviations (span window), the EWMA control chart;
+//     O(1) state
+//   mad: distance from the median of the last window values in scaled
+//     median absolute deviations (1.4826 MAD estimates sigma for normal
+//     data), which one outlier cannot move; a sorted window, O(window)
+// The first window values only warm the detector up and are never flagged.
+class AnomalyDetector {
+public:
+    AnomalyDetector(AnomalyMethod method = ANOMALY_ZSCORE, size_t window = 100, double threshold = 3.0);
+
+    // Scores x, adds it and returns whether |score| exceeds the threshold
+    bool add(double x);
+    double last_score() const { return score; }
+    size_t seen() const { return count; }
+
+private:
+    AnomalyMethod method;
+    size_t window;
+    double threshold;
+    size_t count = 0;
+    double score = 0.0;
+
+    // zscore: last window values and their sums relative to shift
+    deque<double> recent;
+    double shift = 0.0, sum = 0.0, sum_sq = 0.0;
+    // ewma
+    double mean = 0.0, variance = 0.0;
+    // mad: recent in ascending order
+    vector<double> sorted;
+
+    double evaluate(double x) const;
+    double median_absolute_deviation(double median) const;
+};
+
+#endif // ANOMALIES_H
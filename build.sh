@@ -2,7 +2,7 @@
 
 # Set compiler and flags
 CXX="g++"
-CXXFLAGS="-std=c++11 -Wall -I."
+CXXFLAGS="-std=c++11 -O2 -Wall -pthread -I."
 
 # Clean previous builds
 echo "🧹 Cleaning previous builds..."
@@ -12,11 +12,33 @@ rm -f *.o compiler_main program generated.cpp
 echo "🔨 Compiling object files..."
 ${CXX} ${CXXFLAGS} -c tokenizer_parser.cpp -o tokenizer_parser.o
 ${CXX} ${CXXFLAGS} -c main.cpp -o main.o
+${CXX} ${CXXFLAGS} -c parallel.cpp -o parallel.o
+${CXX} ${CXXFLAGS} -c stats_engine.cpp -o stats_engine.o
+${CXX} ${CXXFLAGS} -c sketches.cpp -o sketches.o
+${CXX} ${CXXFLAGS} -c columns.cpp -o columns.o
+${CXX} ${CXXFLAGS} -c kernels.cpp -o kernels.o
+${CXX} ${CXXFLAGS} -c sorting.cpp -o sorting.o
+${CXX} ${CXXFLAGS} -c external_sort.cpp -o external_sort.o
+${CXX} ${CXXFLAGS} -c tables.cpp -o tables.o
+${CXX} ${CXXFLAGS} -c aggregation.cpp -o aggregation.o
+${CXX} ${CXXFLAGS} -c join.cpp -o join.o
+${CXX} ${CXXFLAGS} -c filter.cpp -o filter.o
+${CXX} ${CXXFLAGS} -c view.cpp -o view.o
+${CXX} ${CXXFLAGS} -c indexes.cpp -o indexes.o
+${CXX} ${CXXFLAGS} -c window_functions.cpp -o window_functions.o
+${CXX} ${CXXFLAGS} -c timestamps.cpp -o timestamps.o
+${CXX} ${CXXFLAGS} -c seasonal.cpp -o seasonal.o
+${CXX} ${CXXFLAGS} -c anomalies.cpp -o anomalies.o
+${CXX} ${CXXFLAGS} -c follow.cpp -o follow.o
+${CXX} ${CXXFLAGS} -c models.cpp -o models.o
+${CXX} ${CXXFLAGS} -c sgd.cpp -o sgd.o
+${CXX} ${CXXFLAGS} -c validation.cpp -o validation.o
+${CXX} ${CXXFLAGS} -c clustering.cpp -o clustering.o
 ${CXX} ${CXXFLAGS} -c compiler_main.cpp -o compiler_main.o
 
 # Link object files with verbose output
 echo "🔗 Linking..."
-${CXX} ${CXXFLAGS} -v tokenizer_parser.o main.o compiler_main.o -o compiler_main
+${CXX} ${CXXFLAGS} -v tokenizer_parser.o main.o parallel.o stats_engine.o sketches.o columns.o kernels.o sorting.o external_sort.o tables.o aggregation.o join.o filter.o view.o indexes.o window_functions.o timestamps.o seasonal.o anomalies.o follow.o models.o sgd.o validation.o clustering.o compiler_main.o -o compiler_main
 
 if [ $? -eq 0 ]; then
     echo "✅ Compilation successful!"
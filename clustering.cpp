@@ -0,0 +1,149 @@
+#include "clustering.h"
+#include "kernels.h"
+#include "parallel.h"
+#include <limits>
+#include <random>
+
+namespace {
+
+// Points per parallel chunk of the centroid update
+const size_t UPDATE_GRAIN = 1 << 15;
+// Points the mini-batch variant seeds its centroids from
+const size_t SEED_SAMPLE = 1 << 16;
+
+// Feature-major copy of the given points of x (n points)
+vector<double> gather_points(const vector<double>& x, size_t n, size_t d, const vector<size_t>& points) {
+    const size_t m = points.size();
+    vector<double> out(m * d);
+    for (size_t j = 0; j < d; ++j) {
+        for (size_t i = 0; i < m; ++i) out[j * m + i] = x[j * n + points[i]];
+    }
+    return out;
+}
+
+void copy_point(const vector<double>& x, size_t n, size_t d, size_t point, double* centroid) {
+    for (size_t j = 0; j < d; ++j) centroid[j] = x[j * n + point];
+}
+
+// k-means++: each next centroid is a point drawn with probability
+// proportional to its squared distance from the nearest centroid so far
+vector<double> seed_centroids(const vector<double>& x, size_t n, size_t d, size_t k, mt19937_64& rng) {
+    vector<double> centroids(k * d), nearest(n, numeric_limits<double>::infinity()), distances(n);
+    vector<int> labels(n);
+    for (size_t c = 0; c < k; ++c) {
+        size_t chosen = rng() % n;
+        if (c > 0) {
+            double total = kernel_sum(nearest.data(), n).sum;
+            // With fewer distinct points than k every distance can be zero
+            if (total > 0) {
+                double target = uniform_real_distribution<double>(0.0, total)(rng), running = 0.0;
+                for (size_t i = 0; i < n; ++i) {
+                    if (nearest[i] <= 0) continue;
+                    chosen = i;
+                    running += nearest[i];
+                    if (running >= target) break;
+                }
+            }
+        }
+        copy_point(x, n, d, chosen, &centroids[c * d]);
+        kernel_nearest(x.data(), n, n, d, &centroids[c * d], 1, labels.data(), distances.data());
+        for (size_t i = 0; i < n; ++i) nearest[i] = min(nearest[i], distances[i]);
+    }
+    return centroids;
+}
+
+// Recomputes each centroid as the mean of its points from per-chunk sums;
+// empty clusters take the points farthest from their centroids
+void update_centroids(const vector<double>& x, size_t n, size_t d, size_t k, const vector<int>& labels,
+                      vector<double> distances, vector<double>& centroids) {
+    struct Partial {
+        vector<double> sums;
+        vector<size_t> counts;
+    };
+    vector<Partial> partials(chunk_count(n, UPDATE_GRAIN));
+    parallel_for(n, UPDATE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        Partial& acc = partials[chunk];
+        acc.sums.assign(k * d, 0.0);
+        acc.counts.assign(k, 0);
+        for (size_t i = begin; i < end; ++i) acc.counts[labels[i]]++;
+        for (size_t j = 0; j < d; ++j) {
+            const double* feature = &x[j * n];
+            for (size_t i = begin; i < end; ++i) acc.sums[labels[i] * d + j] += feature[i];
+        }
+    });
+
+    vector<double> sums(k * d, 0.0);
+    vector<size_t> counts(k, 0);
+    for (const Partial& part : partials) {
+        for (size_t i = 0; i < k * d; ++i) sums[i] += part.sums[i];
+        for (size_t c = 0; c < k; ++c) counts[c] += part.counts[c];
+    }
+    for (size_t c = 0; c < k; ++c) {
+        if (counts[c] == 0) {
+            size_t farthest = max_element(distances.begin(), distances.end()) - distances.begin();
+            copy_point(x, n, d, farthest, &centroids[c * d]);
+            distances[farthest] = 0.0;
+            continue;
+        }
+        for (size_t j = 0; j < d; ++j) centroids[c * d + j] = sums[c * d + j] / counts[c];
+    }
+}
+
+} // namespace
+
+KMeansResult kmeans(const vector<double>& x, size_t n, size_t d, const KMeansOptions& options) {
+    const size_t k = options.k;
+    KMeansResult result;
+    mt19937_64 rng(options.seed);
+    vector<double> distances(n);
+    vector<int> labels(n);
+
+    if (options.batch_size == 0) {
+        result.centroids = seed_centroids(x, n, d, k, rng);
+        result.labels.assign(n, -1);
+        for (result.iterations = 1; result.iterations <= options.max_iterations; ++result.iterations) {
+            kernel_nearest(x.data(), n, n, d, result.centroids.data(), k, labels.data(), distances.data());
+            if (labels == result.labels) {
+                result.converged = true;
+                break;
+            }
+            result.labels.swap(labels);
+            update_centroids(x, n, d, k, result.labels, distances, result.centroids);
+        }
+        result.iterations = min(result.iterations, options.max_iterations);
+    } else {
+        vector<size_t> sample;
+        if (n <= SEED_SAMPLE) {
+            sample.resize(n);
+            for (size_t i = 0; i < n; ++i) sample[i] = i;
+        } else {
+            for (size_t i = 0; i < SEED_SAMPLE; ++i) sample.push_back(rng() % n);
+        }
+        result.centroids = seed_centroids(gather_points(x, n, d, sample), sample.size(), d, k, rng);
+
+        const size_t b = options.batch_size;
+        vector<size_t> batch(b), seen(k, 0);
+        vector<int> batch_labels(b);
+        vector<double> batch_distances(b);
+        for (result.iterations = 0; result.iterations < options.max_iterations; ++result.iterations) {
+            for (size_t& point : batch) point = rng() % n;
+            vector<double> points = gather_points(x, n, d, batch);
+            kernel_nearest(points.data(), b, b, d, result.centroids.data(), k, batch_labels.data(),
+                           batch_distances.data());
+            for (size_t r = 0; r < b; ++r) {
+                const size_t c = batch_labels[r];
+                const double rate = 1.0 / ++seen[c];
+                double* centroid = &result.centroids[c * d];
+                for (size_t j = 0; j < d; ++j) centroid[j] += rate * (points[j * b + r] - centroid[j]);
+            }
+        }
+    }
+
+    // Final assignment against the final centroids
+    kernel_nearest(x.data(), n, n, d, result.centroids.data(), k, labels.data(), distances.data());
+    result.labels.swap(labels);
+    result.inertia = kernel_sum(distances.data(), n).sum;
+    result.sizes.assign(k, 0);
+    for (int label : result.labels) result.sizes[label]++;
+    return result;
+}
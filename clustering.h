@@ -0,0 +1,32 @@
+#ifndef CLUSTERING_H
+#define CLUSTERING_H
+
+#include "main.h"
+
+struct KMeansOptions {
+    size_t k = 8;
+    size_t max_iterations = 100;
+    size_t batch_size = 0;     // 0 runs full Lloyd iterations, otherwise mini-batches of this many rows
+    unsigned seed = 42;
+};
+
+struct KMeansResult {
+    vector<double> centroids;  // k rows of d values
+    vector<int> labels;        // cluster of each point
+    vector<size_t> sizes;      // points per cluster
+    double inertia = 0.0;      // sum of squared distances to the assigned centroids
+    size_t iterations = 0;
+    bool converged = false;    // Lloyd only: no point changed cluster in the last iteration
+};
+
+// k-means over n points of d features stored feature-major in x (feature j
+// of point i at x[j * n + i]). Centroids start from k-means++ seeding, run
+// on a sample when mini-batching. Lloyd iterations assign every point with
+// the vectorised kernel_nearest and recompute the centroids from per-thread
+// partial sums; a cluster left empty is reseeded with the point farthest
+// from its centroid. The mini-batch variant (Sculley 2010) instead moves
+// each centroid towards the sampled points assigned to it with a per-centroid
+// learning rate of 1 / points seen, then assigns every point once.
+KMeansResult kmeans(const vector<double>& x, size_t n, size_t d, const KMeansOptions& options);
+
+#endif // CLUSTERING_H
@@ -0,0 +1,327 @@
+#include "columns.h"
+#include "parallel.h"
+#include "sketches.h"
+#include "indexes.h"
+#include "kernels.h"
+#include "tables.h"
+#include "view.h"
+#include <iomanip>
+#include <memory>
+#include <unordered_map>
+
+namespace {
+
+// Rows per parse chunk
+const size_t PARSE_GRAIN = 8192;
+
+vector<unique_ptr<NumericColumn>> numeric_cache;
+
+// Versions: the last one handed out, the one of the whole dataset and later
+// ones of single columns
+uint64_t version_counter = 1;
+uint64_t dataset_version = 1;
+vector<uint64_t> column_versions;
+
+void dataset_changed() {
+    dataset_version = ++version_counter;
+    column_versions.clear();
+}
+
+void column_changed(size_t col) {
+    if (column_versions.size() <= col) column_versions.resize(col + 1, 0);
+    column_versions[col] = ++version_counter;
+}
+
+// Hashes and compares cells in place so dictionaries never copy strings
+struct CellHash {
+    size_t operator()(const string* s) const { return static_cast<size_t>(hash_string(*s)); }
+};
+struct CellEqual {
+    bool operator()(const string* a, const string* b) const { return *a == *b; }
+};
+typedef unordered_map<const string*, uint32_t, CellHash, CellEqual> CellDictionary;
+
+// Zones per parallel task when building zone maps
+const size_t ZONE_GRAIN = 16;
+
+// Recomputes the zones from first_zone on, so appended rows only redo the
+// last zone and their own
+void build_zone_map(NumericColumn& column, size_t first_zone = 0) {
+    const size_t zones = (column.values.size() + ZONE_ROWS - 1) / ZONE_ROWS;
+    column.zone_min.resize(zones, 0.0);
+    column.zone_max.resize(zones, 0.0);
+    parallel_for(zones - min(first_zone, zones), ZONE_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t zone = first_zone + begin; zone < first_zone + end; ++zone) {
+            size_t first = zone * ZONE_ROWS;
+            MinMaxResult bounds = kernel_min_max(column.values.data() + first, min(ZONE_ROWS, column.values.size() - first));
+            column.zone_min[zone] = bounds.min;
+            column.zone_max[zone] = bounds.max;
+        }
+    });
+}
+
+// Parses data rows first .. end of column col onto the end of column
+void parse_rows(size_t col, size_t first, NumericColumn& column) {
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    column.values.resize(rows, numeric_limits<double>::quiet_NaN());
+
+    vector<size_t> valid(chunk_count(rows - first, PARSE_GRAIN), 0), nulls(valid.size(), 0);
+    parallel_for(rows - first, PARSE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        double* out = column.values.data() + first;
+        for (size_t row = begin; row < end; ++row) {
+            const string& cell = dataset[first + row + 1].data[col];
+            if (is_null_value(cell)) {
+                nulls[chunk]++;
+            } else if (parse_double(cell, out[row])) {
+                valid[chunk]++;
+            }
+        }
+    });
+    for (size_t chunk = 0; chunk < valid.size(); ++chunk) {
+        column.valid += valid[chunk];
+        column.nulls += nulls[chunk];
+    }
+}
+
+} // namespace
+
+int find_column(const string& name) {
+    if (dataset.empty()) return -1;
+    vector<size_t> cols = view_columns();
+    for (size_t i = 0; i < cols.size(); ++i) {
+        if (dataset[0].data[cols[i]] == name) return static_cast<int>(cols[i]);
+    }
+    return -1;
+}
+
+vector<string> split_list(const string& list) {
+    vector<string> items;
+    stringstream ss(list);
+    string item;
+    while (getline(ss, item, ',')) {
+        size_t begin = item.find_first_not_of(" \t");
+        if (begin == string::npos) continue;
+        items.push_back(item.substr(begin, item.find_last_not_of(" \t") - begin + 1));
+    }
+    return items;
+}
+
+bool find_columns(const string& list, vector<size_t>& cols, string& error) {
+    cols.clear();
+    int exact = find_column(list);
+    if (exact != -1) {
+        cols.push_back(exact);
+        return true;
+    }
+
+    vector<string> names = split_list(list);
+    for (size_t i = 0; i < names.size(); ++i) {
+        int index = find_column(names[i]);
+        if (index == -1) {
+            error = "Column not found: " + names[i];
+            return false;
+        }
+        cols.push_back(index);
+    }
+    if (cols.empty()) {
+        error = "No columns given";
+        return false;
+    }
+    return true;
+}
+
+string format_number(double value) {
+    ostringstream out;
+    out << setprecision(12) << value;
+    return out.str();
+}
+
+DictionaryColumn dictionary_column(size_t col) {
+    DictionaryColumn column;
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    column.ids.resize(rows);
+
+    // Local ids per chunk first, then one global id per distinct cell
+    vector<vector<const string*>> local_values(chunk_count(rows, PARSE_GRAIN));
+    parallel_for(rows, PARSE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        CellDictionary ids;
+        for (size_t row = begin; row < end; ++row) {
+            const string* cell = &dataset[row + 1].data[col];
+            auto inserted = ids.insert(make_pair(cell, static_cast<uint32_t>(local_values[chunk].size())));
+            if (inserted.second) local_values[chunk].push_back(cell);
+            column.ids[row] = inserted.first->second;
+        }
+    });
+
+    CellDictionary global;
+    vector<vector<uint32_t>> remap(local_values.size());
+    for (size_t chunk = 0; chunk < local_values.size(); ++chunk) {
+        for (size_t i = 0; i < local_values[chunk].size(); ++i) {
+            const string* cell = local_values[chunk][i];
+            auto inserted = global.insert(make_pair(cell, static_cast<uint32_t>(column.values.size())));
+            if (inserted.second) column.values.push_back(*cell);
+            remap[chunk].push_back(inserted.first->second);
+        }
+    }
+
+    parallel_for(rows, PARSE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) column.ids[row] = remap[chunk][column.ids[row]];
+    });
+    return column;
+}
+
+const NumericColumn& numeric_column(size_t col) {
+    if (numeric_cache.size() <= col) numeric_cache.resize(col + 1);
+    if (numeric_cache[col]) return *numeric_cache[col];
+
+    unique_ptr<NumericColumn> column(new NumericColumn());
+    parse_rows(col, 0, *column);
+    build_zone_map(*column);
+
+    numeric_cache[col] = move(column);
+    return *numeric_cache[col];
+}
+
+bool is_numeric_column(size_t col) {
+    const NumericColumn& column = numeric_column(col);
+    return column.valid > 0 && column.valid + column.nulls == column.values.size();
+}
+
+void invalidate_columns() {
+    numeric_cache.clear();
+    invalidate_indexes();
+    dataset_changed();
+}
+
+void invalidate_column(size_t col) {
+    if (col < numeric_cache.size()) numeric_cache[col].reset();
+    invalidate_indexes();
+    column_changed(col);
+}
+
+void store_numeric_column(size_t col, const vector<double>& values) {
+    parallel_for(values.size(), PARSE_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            if (values[row] == values[row]) {
+                dataset[row + 1].data[col] = to_string(values[row]);
+            }
+        }
+    });
+
+    // The text form is rounded, so the column is re-parsed on next use
+    if (col < numeric_cache.size()) numeric_cache[col].reset();
+    invalidate_indexes();
+    column_changed(col);
+}
+
+size_t write_numeric_column(const string& name, const vector<double>& values, size_t first_row) {
+    int found = find_column(name);
+    size_t col = found == -1 ? dataset[0].data.size() : static_cast<size_t>(found);
+    if (found == -1) dataset[0].data.push_back(name);
+
+    const size_t rows = dataset.size() - 1;
+    parallel_for(rows, PARSE_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t row = max(begin, found == -1 ? 0 : first_row); row < end; ++row) {
+            double x = row < first_row ? numeric_limits<double>::quiet_NaN() : values[row - first_row];
+            string cell = x == x ? format_number(x) : string();
+            if (found == -1) dataset[row + 1].data.push_back(move(cell));
+            else dataset[row + 1].data[col] = move(cell);
+        }
+    });
+
+    if (col < numeric_cache.size()) numeric_cache[col].reset();
+    invalidate_indexes();
+    column_changed(col);
+    return col;
+}
+
+void append_rows(vector<CSVRow>&& rows) {
+    if (rows.empty()) return;
+    const size_t first = dataset.size() - 1, width = dataset[0].data.size();
+    dataset.reserve(dataset.size() + rows.size());
+    for (CSVRow& row : rows) {
+        row.data.resize(width);
+        dataset.push_back(move(row));
+    }
+    rows.clear();
+
+    for (size_t col = 0; col < numeric_cache.size(); ++col) {
+        if (!numeric_cache[col]) continue;
+        parse_rows(col, first, *numeric_cache[col]);
+        build_zone_map(*numeric_cache[col], first / ZONE_ROWS);
+    }
+    invalidate_indexes();
+}
+
+uint64_t rows_version() {
+    return dataset_version;
+}
+
+uint64_t column_version(size_t col) {
+    return col < column_versions.size() ? max(dataset_version, column_versions[col]) : dataset_version;
+}
+
+size_t RowWatermark::covered(const vector<size_t>& columns) const {
+    if (columns != cols || dataset.empty() || rows > dataset.size() - 1) return 0;
+    for (size_t i = 0; i < cols.size(); ++i) {
+        if (column_version(cols[i]) != versions[i]) return 0;
+    }
+    return rows;
+}
+
+void RowWatermark::advance(const vector<size_t>& columns) {
+    cols = columns;
+    versions.resize(cols.size());
+    for (size_t i = 0; i < cols.size(); ++i) versions[i] = column_version(cols[i]);
+    rows = dataset.empty() ? 0 : dataset.size() - 1;
+}
+
+void reorder_rows(const vector<size_t>& order) {
+    reorder_partitions(order, dataset.size() - 1);
+    invalidate_indexes();
+    dataset_changed();
+    vector<CSVRow> rows(order.size() + 1);
+    rows[0] = move(dataset[0]);
+    parallel_for(order.size(), PARSE_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            rows[i + 1] = move(dataset[order[i] + 1]);
+        }
+    });
+    dataset.swap(rows);
+
+    for (size_t col = 0; col < numeric_cache.size(); ++col) {
+        if (!numeric_cache[col]) continue;
+        NumericColumn& column = *numeric_cache[col];
+        vector<double> values(order.size());
+        for (size_t i = 0; i < order.size(); ++i) values[i] = column.values[order[i]];
+        const bool subset = order.size() != column.values.size();
+        column.values.swap(values);
+        build_zone_map(column);
+
+        // A subset of the rows needs its counts redone
+        if (!subset) continue;
+        column.valid = column.nulls = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (column.values[i] == column.values[i]) column.valid++;
+            else if (is_null_value(dataset[i + 1].data[col])) column.nulls++;
+        }
+    }
+}
+
+void project_columns(const vector<size_t>& cols) {
+    parallel_for(dataset.size(), PARSE_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            vector<string> cells(cols.size());
+            for (size_t c = 0; c < cols.size(); ++c) cells[c] = move(dataset[i].data[cols[c]]);
+            dataset[i].data.swap(cells);
+        }
+    });
+
+    vector<unique_ptr<NumericColumn>> cache(cols.size());
+    for (size_t c = 0; c < cols.size(); ++c) {
+        if (cols[c] < numeric_cache.size()) cache[c] = move(numeric_cache[cols[c]]);
+    }
+    numeric_cache.swap(cache);
+    invalidate_indexes();
+    dataset_changed();
+}
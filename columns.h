@@ -0,0 +1,102 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include "main.h"
+#include <cstdint>
+#include <limits>
+
+// Rows per zone of a column's zone map
+const size_t ZONE_ROWS = 4096;
+
+// Contiguous numeric copy of one dataset column for the vectorised kernels.
+// values[i] holds data row i + 1; null and non-numeric cells are NaN.
+struct NumericColumn {
+    vector<double> values;
+    size_t valid = 0;         // cells that parsed as numbers
+    size_t nulls = 0;
+    vector<double> zone_min;  // min and max of the numbers in each run of
+    vector<double> zone_max;  // ZONE_ROWS rows (inf and -inf when none)
+};
+
+// Index of a header column in the current view, or -1 when it does not exist
+int find_column(const string& name);
+
+// Items of a comma-separated list, trimmed, empty items dropped
+vector<string> split_list(const string& list);
+
+// Resolves a comma-separated list of column names (a name that matches a
+// column exactly is taken whole). False with error set on an unknown name.
+bool find_columns(const string& list, vector<size_t>& cols, string& error);
+
+// Compact text form for computed values (up to 12 significant digits)
+string format_number(double value);
+
+// Dictionary encoding of one column: ids[i] is the dense id of data row i
+// and values[id] its cell, ids numbered in order of first appearance
+struct DictionaryColumn {
+    vector<uint32_t> ids;
+    vector<string> values;
+};
+
+// Encodes column col with per-chunk dictionaries merged in row order
+DictionaryColumn dictionary_column(size_t col);
+
+// Parses column col once (in parallel) and caches the result until the
+// dataset changes. Must be called from the main thread.
+const NumericColumn& numeric_column(size_t col);
+
+// True when every non-null cell of column col parses as a number
+bool is_numeric_column(size_t col);
+
+// Drops cached columns; every function that modifies the dataset calls this
+void invalidate_columns();
+
+// Drops what is cached for column col alone, after its cells were rewritten in
+// place; results maintained over other columns stay valid
+void invalidate_column(size_t col);
+
+// Writes values back into column col of the dataset (NaN entries are left
+// untouched) and refreshes the cache entry
+void store_numeric_column(size_t col, const vector<double>& values);
+
+// Writes values into column name from data row first_row on, appending the
+// column (empty above first_row) when it does not exist; NaN entries become
+// empty cells. Returns the column's index.
+size_t write_numeric_column(const string& name, const vector<double>& values, size_t first_row = 0);
+
+// Appends data rows, padding short ones with empty cells, and extends the
+// cached columns by parsing only the new rows. Rows appended this way do not
+// change any column_version.
+void append_rows(vector<CSVRow>&& rows);
+
+// Changes whenever column col changes other than by append_rows
+uint64_t column_version(size_t col);
+
+// Changes whenever rows are reordered or narrowed, columns renumbered or the
+// dataset replaced: every change but append_rows and writes to single columns
+uint64_t rows_version();
+
+// How far a maintained result has read the dataset: results kept across
+// calls (follow mode) record the columns they read after each update and
+// then only process the rows appended since
+struct RowWatermark {
+    vector<size_t> cols;
+    vector<uint64_t> versions;
+    size_t rows = 0;
+
+    // Data rows the result still holds for: all it has seen while cols have
+    // only had rows appended since, else 0
+    size_t covered(const vector<size_t>& columns) const;
+    // Marks every current row of columns as seen
+    void advance(const vector<size_t>& columns);
+};
+
+// Moves data row order[i] + 1 to position i + 1 and permutes cached columns
+// the same way, so a reorder never forces a re-parse
+void reorder_rows(const vector<size_t>& order);
+
+// Keeps columns cols of every row, in that order, moving the cells and the
+// cached columns rather than copying them
+void project_columns(const vector<size_t>& cols);
+
+#endif // COLUMNS_H
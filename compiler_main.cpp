@@ -29,7 +29,12 @@ int main() {
         cout << "Debug: Parsing and C++ code generation complete." << endl;
 
         // Compile the generated code
-        string compile_command = "g++ -std=c++11 -o program generated.cpp main.cpp tokenizer_parser.cpp";
+        string compile_command = "g++ -std=c++11 -O2 -pthread -o program generated.cpp main.cpp tokenizer_parser.cpp "
+                                  "parallel.cpp stats_engine.cpp sketches.cpp columns.cpp kernels.cpp sorting.cpp "
+                                  "external_sort.cpp tables.cpp aggregation.cpp join.cpp filter.cpp "
+                                  "view.cpp indexes.cpp window_functions.cpp timestamps.cpp seasonal.cpp "
+                                  "anomalies.cpp follow.cpp models.cpp sgd.cpp validation.cpp "
+                                  "clustering.cpp";
         if (system(compile_command.c_str()) != 0) {
             cerr << "\n❌ Compilation failed.\n";
             return 1;
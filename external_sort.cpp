@@ -0,0 +1,385 @@
+#include "external_sort.h"
+#include "timestamps.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+// Bytes buffered per open file; the merge fan-in is derived from this
+const size_t IO_BUFFER = 1 << 20;
+const size_t MAX_FAN_IN = 128;
+// Rough per-row bookkeeping on top of the line itself
+const size_t RECORD_OVERHEAD = 64;
+
+enum KeyRank : uint8_t { RANK_FIRST = 0, RANK_LOW = 1, RANK_HIGH = 2, RANK_LAST = 3 };
+
+// One encoded key value. Numbers carry order-preserving bits, text carries
+// the cell; direction is already folded into rank and bits.
+struct KeyPart {
+    uint8_t rank;
+    bool is_text;
+    uint64_t bits;
+    string text;
+};
+
+struct Record {
+    vector<KeyPart> keys;
+    string line;
+};
+
+bool record_less(const Record& a, const Record& b, const vector<SortKey>& keys) {
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const KeyPart& x = a.keys[k];
+        const KeyPart& y = b.keys[k];
+        if (x.rank != y.rank) return x.rank < y.rank;
+        if (x.is_text) {
+            int c = x.text.compare(y.text);
+            if (c != 0) return keys[k].ascending ? c < 0 : c > 0;
+        } else if (x.bits != y.bits) {
+            return x.bits < y.bits;
+        }
+    }
+    return false;
+}
+
+void encode_record(const vector<string>& cells, const vector<SortKey>& keys, Record& record) {
+    record.keys.resize(keys.size());
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const SortKey& key = keys[k];
+        const string& cell = cells[key.column];
+        KeyPart& part = record.keys[k];
+        part.is_text = false;
+        part.bits = 0;
+        part.text.clear();
+
+        if (is_null_value(cell)) {
+            part.rank = key.nulls_first ? RANK_FIRST : RANK_LAST;
+            continue;
+        }
+        // Timestamps order by instant, as epoch seconds among the numbers. An
+        // epoch-millisecond number is scaled to seconds too, as sort_data reads
+        // it, keeping the fraction so distinct milliseconds stay ordered
+        double v;
+        int64_t seconds;
+        bool number = parse_double(cell, v);
+        if (parse_timestamp(cell, seconds)) {
+            if (!number) v = static_cast<double>(seconds);
+            else if (seconds != static_cast<int64_t>(v)) v /= 1000;
+            number = true;
+        }
+        if (number) {
+            if (v == 0) v = 0.0;
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            bits = (bits >> 63) ? ~bits : bits | (static_cast<uint64_t>(1) << 63);
+            part.rank = key.ascending ? RANK_LOW : RANK_HIGH;
+            part.bits = key.ascending ? bits : ~bits;
+        } else {
+            part.rank = key.ascending ? RANK_HIGH : RANK_LOW;
+            part.is_text = true;
+            part.text = cell;
+        }
+    }
+}
+
+// Buffered binary/text writer
+class OutputBuffer {
+public:
+    explicit OutputBuffer(const string& path) : file_(path, ios::binary) { buffer_.reserve(IO_BUFFER); }
+    ~OutputBuffer() { flush(); }
+
+    bool is_open() const { return file_.is_open(); }
+    bool good() { flush(); return static_cast<bool>(file_); }
+
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        buffer_.insert(buffer_.end(), bytes, bytes + size);
+        if (buffer_.size() >= IO_BUFFER) flush();
+    }
+    void write_string(const string& s) {
+        uint32_t size = static_cast<uint32_t>(s.size());
+        write(&size, sizeof(size));
+        write(s.data(), s.size());
+    }
+    void flush() {
+        if (!buffer_.empty()) file_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+private:
+    ofstream file_;
+    vector<char> buffer_;
+};
+
+void write_record(OutputBuffer& out, const Record& record) {
+    for (size_t k = 0; k < record.keys.size(); ++k) {
+        const KeyPart& part = record.keys[k];
+        out.write(&part.rank, 1);
+        if (part.rank == RANK_FIRST || part.rank == RANK_LAST) continue;
+        uint8_t is_text = part.is_text;
+        out.write(&is_text, 1);
+        if (part.is_text) {
+            out.write_string(part.text);
+        } else {
+            out.write(&part.bits, sizeof(part.bits));
+        }
+    }
+    out.write_string(record.line);
+}
+
+// Reads records back from a run file, refilling a read-ahead buffer in
+// large blocks so the merge does few, sequential reads per run
+class RunReader {
+public:
+    RunReader(const string& path, size_t key_count, size_t buffer_size)
+        : file_(path, ios::binary), key_count_(key_count), buffer_(buffer_size), begin_(0), end_(0) {}
+
+    bool next(Record& record) {
+        record.keys.resize(key_count_);
+        for (size_t k = 0; k < key_count_; ++k) {
+            KeyPart& part = record.keys[k];
+            if (!read(&part.rank, 1)) return false;
+            part.is_text = false;
+            part.bits = 0;
+            part.text.clear();
+            if (part.rank == RANK_FIRST || part.rank == RANK_LAST) continue;
+            uint8_t is_text;
+            if (!read(&is_text, 1)) return false;
+            part.is_text = is_text != 0;
+            if (part.is_text ? !read_string(part.text) : !read(&part.bits, sizeof(part.bits))) return false;
+        }
+        return read_string(record.line);
+    }
+
+private:
+    bool fill(size_t need) {
+        if (end_ - begin_ >= need) return true;
+        memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        if (buffer_.size() < need) buffer_.resize(need);
+        file_.read(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += static_cast<size_t>(file_.gcount());
+        return end_ >= need;
+    }
+    bool read(void* out, size_t size) {
+        if (!fill(size)) return false;
+        memcpy(out, buffer_.data() + begin_, size);
+        begin_ += size;
+        return true;
+    }
+    bool read_string(string& s) {
+        uint32_t size;
+        if (!read(&size, sizeof(size)) || !fill(size)) return false;
+        s.assign(buffer_.data() + begin_, size);
+        begin_ += size;
+        return true;
+    }
+
+    ifstream file_;
+    size_t key_count_;
+    vector<char> buffer_;
+    size_t begin_, end_;
+};
+
+// Tournament tree over the run heads: tree_[0] is the current winner and
+// each internal node keeps the loser of its match, so replacing the winner
+// replays only one leaf-to-root path (log2 k comparisons)
+class LoserTree {
+public:
+    LoserTree(const vector<Record>& heads, const vector<bool>& live, const vector<SortKey>& keys)
+        : heads_(heads), live_(live), keys_(keys), k_(heads.size()), tree_(heads.size()) {
+        if (k_ == 1) {
+            tree_[0] = 0;
+            return;
+        }
+        // Nodes 1..k-1 are internal, leaf i sits at node k + i
+        vector<size_t> winner(k_);
+        for (size_t node = k_ - 1; node >= 1; --node) {
+            size_t a = child_winner(winner, 2 * node);
+            size_t b = child_winner(winner, 2 * node + 1);
+            if (beats(a, b)) {
+                winner[node] = a;
+                tree_[node] = b;
+            } else {
+                winner[node] = b;
+                tree_[node] = a;
+            }
+        }
+        tree_[0] = winner[1];
+    }
+
+    size_t winner() const { return tree_[0]; }
+
+    // Call after the winner's head was replaced (or its run ran out)
+    void replay() {
+        size_t s = tree_[0];
+        for (size_t node = (s + k_) / 2; node >= 1; node /= 2) {
+            if (beats(tree_[node], s)) swap(s, tree_[node]);
+        }
+        tree_[0] = s;
+    }
+
+private:
+    size_t child_winner(const vector<size_t>& winner, size_t node) const {
+        return node >= k_ ? node - k_ : winner[node];
+    }
+    // Exhausted runs lose every match; ties go to the earlier run, which
+    // keeps the merge stable
+    bool beats(size_t a, size_t b) const {
+        if (!live_[a]) return false;
+        if (!live_[b]) return true;
+        if (record_less(heads_[a], heads_[b], keys_)) return true;
+        if (record_less(heads_[b], heads_[a], keys_)) return false;
+        return a < b;
+    }
+
+    const vector<Record>& heads_;
+    const vector<bool>& live_;
+    const vector<SortKey>& keys_;
+    size_t k_;
+    vector<size_t> tree_;
+};
+
+// Merges runs into a new run file, or into the CSV output when header is set
+bool merge_runs(const vector<string>& runs, const string& output, const vector<SortKey>& keys,
+                const string* header, size_t buffer_size) {
+    OutputBuffer out(output);
+    if (!out.is_open()) return false;
+    if (header) {
+        out.write(header->data(), header->size());
+        out.write("\n", 1);
+    }
+    if (runs.empty()) return out.good();
+
+    vector<unique_ptr<RunReader>> readers;
+    vector<Record> heads(runs.size());
+    vector<bool> live(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+        readers.push_back(unique_ptr<RunReader>(new RunReader(runs[i], keys.size(), buffer_size)));
+        live[i] = readers[i]->next(heads[i]);
+    }
+
+    LoserTree tree(heads, live, keys);
+    while (live[tree.winner()]) {
+        size_t w = tree.winner();
+        if (header) {
+            out.write(heads[w].line.data(), heads[w].line.size());
+            out.write("\n", 1);
+        } else {
+            write_record(out, heads[w]);
+        }
+        live[w] = readers[w]->next(heads[w]);
+        tree.replay();
+    }
+    return out.good();
+}
+
+void remove_files(const vector<string>& paths) {
+    for (size_t i = 0; i < paths.size(); ++i) remove(paths[i].c_str());
+}
+
+} // namespace
+
+bool external_sort(const string& input_file, const string& output_file, const string& spec,
+                   bool ascending, size_t memory_bytes, ExternalSortStats& stats, string& error) {
+    ifstream input(input_file);
+    if (!input.is_open()) {
+        error = "Could not open file " + input_file;
+        return false;
+    }
+
+    string header;
+    if (!getline(input, header)) {
+        error = "Empty file " + input_file;
+        return false;
+    }
+    vector<string> columns;
+    stringstream header_stream(header);
+    string cell;
+    while (getline(header_stream, cell, ',')) columns.push_back(cell);
+
+    vector<SortKey> keys;
+    if (!parse_sort_keys(columns, spec, ascending, keys, error)) return false;
+
+    // Phase 1: cut the input into sorted runs of bounded size
+    stats = ExternalSortStats();
+    vector<string> runs;
+    vector<Record> batch;
+    size_t batch_bytes = 0;
+    int run_id = 0;
+    auto spill = [&]() -> bool {
+        if (batch.empty()) return true;
+        stable_sort(batch.begin(), batch.end(), [&](const Record& a, const Record& b) {
+            return record_less(a, b, keys);
+        });
+        string path = output_file + ".run" + to_string(run_id++);
+        OutputBuffer out(path);
+        for (size_t i = 0; i < batch.size(); ++i) write_record(out, batch[i]);
+        runs.push_back(path);
+        batch.clear();
+        batch_bytes = 0;
+        return out.good();
+    };
+
+    string line;
+    vector<string> cells;
+    while (getline(input, line)) {
+        cells.clear();
+        stringstream ss(line);
+        while (getline(ss, cell, ',')) cells.push_back(cell);
+        if (cells.size() != columns.size()) {
+            if (!line.empty()) cerr << "Warning: Skipping malformed row: " << line << endl;
+            continue;
+        }
+
+        batch.push_back(Record());
+        encode_record(cells, keys, batch.back());
+        batch.back().line = line;
+        batch_bytes += line.size() + RECORD_OVERHEAD * (keys.size() + 1);
+        stats.rows++;
+        if (batch_bytes >= memory_bytes && !spill()) {
+            remove_files(runs);
+            error = "Could not write temporary run next to " + output_file;
+            return false;
+        }
+    }
+    if (!spill()) {
+        remove_files(runs);
+        error = "Could not write temporary run next to " + output_file;
+        return false;
+    }
+    stats.runs = runs.size();
+
+    // Phase 2: merge at most fan_in runs at a time until one pass remains
+    size_t fan_in = max<size_t>(2, min(MAX_FAN_IN, memory_bytes / IO_BUFFER));
+    size_t buffer_size = max<size_t>(4096, memory_bytes / (fan_in + 1));
+    while (runs.size() > fan_in) {
+        vector<string> merged;
+        for (size_t begin = 0; begin < runs.size(); begin += fan_in) {
+            vector<string> group(runs.begin() + begin, runs.begin() + min(runs.size(), begin + fan_in));
+            if (group.size() == 1) {
+                merged.push_back(group[0]);
+                continue;
+            }
+            string path = output_file + ".run" + to_string(run_id++);
+            bool ok = merge_runs(group, path, keys, nullptr, buffer_size);
+            remove_files(group);
+            merged.push_back(path);
+            if (!ok) {
+                remove_files(merged);
+                remove_files(vector<string>(runs.begin() + min(runs.size(), begin + fan_in), runs.end()));
+                error = "Could not write temporary run next to " + output_file;
+                return false;
+            }
+        }
+        runs.swap(merged);
+        stats.merge_passes++;
+    }
+
+    bool ok = merge_runs(runs, output_file, keys, &header, buffer_size);
+    remove_files(runs);
+    if (!ok) error = "Could not write file " + output_file;
+    return ok;
+}
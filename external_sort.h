@@ -0,0 +1,21 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include "main.h"
+#include "sorting.h"
+
+struct ExternalSortStats {
+    size_t rows = 0;
+    size_t runs = 0;           // sorted runs spilled to disk
+    size_t merge_passes = 0;   // intermediate merges before the final one
+};
+
+// Sorts the data rows of a CSV file into output_file without loading it:
+// sorted runs of at most memory_bytes are spilled to binary temporary files
+// next to the output and k-way merged. Keys follow parse_sort_keys; within a
+// key, numbers and timestamps (by instant, as epoch seconds) order before text.
+// Returns false (with error set) on failure.
+bool external_sort(const string& input_file, const string& output_file, const string& spec,
+                   bool ascending, size_t memory_bytes, ExternalSortStats& stats, string& error);
+
+#endif // EXTERNAL_SORT_H
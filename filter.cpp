@@ -0,0 +1,481 @@
+#include "filter.h"
+#include "columns.h"
+#include "indexes.h"
+#include "parallel.h"
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+// Selected rows per chunk in leaf evaluation
+const size_t FILTER_GRAIN = 32768;
+// IN lists up to this size are scanned instead of hashed
+const size_t SMALL_IN_LIST = 8;
+// Leaves use an index only when it returns at most 1 / INDEX_SHARE of the
+// incoming selection; past that sorting its hits costs more than a scan
+const size_t INDEX_SHARE = 4;
+
+struct FilterToken {
+    enum Kind { NAME, QUOTED_NAME, NUMBER, TEXT, SYMBOL, END } kind;
+    string text;
+};
+
+bool tokenize_filter(const string& s, vector<FilterToken>& tokens, string& error) {
+    size_t i = 0;
+    while (i < s.size()) {
+        char c = s[i];
+        if (isspace(static_cast<unsigned char>(c))) {
+            ++i;
+            continue;
+        }
+
+        bool after_operand = !tokens.empty() && tokens.back().kind != FilterToken::SYMBOL;
+        if (isdigit(static_cast<unsigned char>(c)) || c == '.' ||
+            (c == '-' && !after_operand && i + 1 < s.size() &&
+             (isdigit(static_cast<unsigned char>(s[i + 1])) || s[i + 1] == '.'))) {
+            size_t start = i++;
+            while (i < s.size() && (isdigit(static_cast<unsigned char>(s[i])) || s[i] == '.' || s[i] == 'e' ||
+                                    s[i] == 'E' || ((s[i] == '-' || s[i] == '+') && (s[i - 1] == 'e' || s[i - 1] == 'E')))) {
+                ++i;
+            }
+            tokens.push_back(FilterToken{FilterToken::NUMBER, s.substr(start, i - start)});
+        } else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = i;
+            while (i < s.size() && (isalnum(static_cast<unsigned char>(s[i])) || s[i] == '_' || s[i] == '.')) ++i;
+            tokens.push_back(FilterToken{FilterToken::NAME, s.substr(start, i - start)});
+        } else if (c == '`' || c == '\'') {
+            // Quoted column name or text literal; a doubled quote escapes itself
+            string text;
+            for (++i;; ++i) {
+                if (i >= s.size()) {
+                    error = "Unterminated quote in filter";
+                    return false;
+                }
+                if (s[i] == c) {
+                    if (i + 1 < s.size() && s[i + 1] == c) {
+                        text += c;
+                        ++i;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                text += s[i];
+            }
+            tokens.push_back(FilterToken{c == '`' ? FilterToken::QUOTED_NAME : FilterToken::TEXT, text});
+        } else if (string("<>!=").find(c) != string::npos) {
+            string op(1, c);
+            if (i + 1 < s.size() && (s[i + 1] == '=' || (c == '<' && s[i + 1] == '>'))) op += s[++i];
+            if (op == "!") {
+                error = "Unexpected '!' in filter";
+                return false;
+            }
+            tokens.push_back(FilterToken{FilterToken::SYMBOL, op == "==" ? "=" : op == "<>" ? "!=" : op});
+            ++i;
+        } else if (c == '(' || c == ')' || c == ',') {
+            tokens.push_back(FilterToken{FilterToken::SYMBOL, string(1, c)});
+            ++i;
+        } else {
+            error = string("Unexpected character '") + c + "' in filter";
+            return false;
+        }
+    }
+    tokens.push_back(FilterToken{FilterToken::END, ""});
+    return true;
+}
+
+// Recursive-descent parser: or > and > not > predicate
+class FilterParser {
+public:
+    FilterParser(const vector<FilterToken>& tokens, string& error) : tokens_(tokens), pos_(0), error_(error) {}
+
+    bool parse(FilterNode& root) {
+        if (!parse_or(root)) return false;
+        if (tokens_[pos_].kind != FilterToken::END) return fail("Unexpected '" + tokens_[pos_].text + "' in filter");
+        return true;
+    }
+
+private:
+    bool keyword(const char* word) const {
+        const FilterToken& token = tokens_[pos_];
+        if (token.kind != FilterToken::NAME || token.text.size() != strlen(word)) return false;
+        for (size_t i = 0; i < token.text.size(); ++i) {
+            if (tolower(static_cast<unsigned char>(token.text[i])) != word[i]) return false;
+        }
+        return true;
+    }
+    bool accept_keyword(const char* word) {
+        if (!keyword(word)) return false;
+        ++pos_;
+        return true;
+    }
+    bool accept_symbol(const char* symbol) {
+        if (tokens_[pos_].kind != FilterToken::SYMBOL || tokens_[pos_].text != symbol) return false;
+        ++pos_;
+        return true;
+    }
+    bool fail(const string& message) {
+        error_ = message;
+        return false;
+    }
+
+    bool parse_or(FilterNode& node) {
+        FilterNode first;
+        if (!parse_and(first)) return false;
+        if (!keyword("or")) {
+            node = move(first);
+            return true;
+        }
+        node.op = FILTER_OR;
+        node.children.push_back(move(first));
+        while (accept_keyword("or")) {
+            node.children.push_back(FilterNode());
+            if (!parse_and(node.children.back())) return false;
+        }
+        return true;
+    }
+
+    bool parse_and(FilterNode& node) {
+        FilterNode first;
+        if (!parse_not(first)) return false;
+        if (!keyword("and")) {
+            node = move(first);
+            return true;
+        }
+        node.op = FILTER_AND;
+        node.children.push_back(move(first));
+        while (accept_keyword("and")) {
+            node.children.push_back(FilterNode());
+            if (!parse_not(node.children.back())) return false;
+        }
+        return true;
+    }
+
+    bool parse_not(FilterNode& node) {
+        if (accept_keyword("not")) {
+            node.op = FILTER_NOT;
+            node.children.push_back(FilterNode());
+            return parse_not(node.children.back());
+        }
+        if (accept_symbol("(")) {
+            if (!parse_or(node)) return false;
+            return accept_symbol(")") || fail("Missing ')' in filter");
+        }
+        return parse_predicate(node);
+    }
+
+    bool parse_literal(FilterNode& node) {
+        const FilterToken& token = tokens_[pos_];
+        if (token.kind == FilterToken::NUMBER) {
+            double value;
+            if (!parse_double(token.text, value)) return fail("Invalid number in filter: " + token.text);
+            node.numbers.push_back(value);
+        } else if (token.kind == FilterToken::TEXT) {
+            node.texts.push_back(token.text);
+        } else {
+            return fail("Expected a value in filter, found '" + token.text + "'");
+        }
+        ++pos_;
+        return true;
+    }
+
+    bool parse_predicate(FilterNode& node) {
+        const FilterToken& name = tokens_[pos_];
+        if (name.kind != FilterToken::NAME && name.kind != FilterToken::QUOTED_NAME) {
+            return fail("Expected a column in filter, found '" + name.text + "'");
+        }
+        int index = find_column(name.text);
+        if (index == -1) return fail("Column not found: " + name.text);
+        node.column = index;
+        ++pos_;
+
+        if (accept_keyword("is")) {
+            node.op = FILTER_IS_NULL;
+            node.negate = accept_keyword("not");
+            return accept_keyword("null") || fail("Expected 'null' after 'is'");
+        }
+        if (accept_keyword("startswith")) {
+            node.op = FILTER_PREFIX;
+            if (tokens_[pos_].kind != FilterToken::TEXT) return fail("startswith needs a quoted text");
+            node.texts.push_back(tokens_[pos_++].text);
+            return true;
+        }
+        node.negate = accept_keyword("not");
+        if (accept_keyword("in")) {
+            node.op = FILTER_IN;
+            if (!accept_symbol("(")) return fail("Expected '(' after 'in'");
+            do {
+                if (!parse_literal(node)) return false;
+            } while (accept_symbol(","));
+            if (!accept_symbol(")")) return fail("Missing ')' after in list");
+
+            // Mixed lists compare as text
+            if (!node.texts.empty()) {
+                for (size_t i = 0; i < node.numbers.size(); ++i) node.texts.push_back(format_number(node.numbers[i]));
+                node.numbers.clear();
+            }
+            node.numeric = node.texts.empty();
+            return true;
+        }
+        if (node.negate) return fail("Expected 'in' after 'not'");
+
+        static const map<string, CompareOp> ops = {
+            {"=", CMP_EQ}, {"!=", CMP_NE}, {"<", CMP_LT}, {"<=", CMP_LE}, {">", CMP_GT}, {">=", CMP_GE}};
+        auto op = tokens_[pos_].kind == FilterToken::SYMBOL ? ops.find(tokens_[pos_].text) : ops.end();
+        if (op == ops.end()) return fail("Expected an operator after " + name.text);
+        ++pos_;
+        node.op = FILTER_COMPARE;
+        node.compare = op->second;
+        if (!parse_literal(node)) return false;
+        node.numeric = !node.numbers.empty();
+        return true;
+    }
+
+    const vector<FilterToken>& tokens_;
+    size_t pos_;
+    string& error_;
+};
+
+// Keeps the rows of the selection that pass test, chunk-parallel. Rows in
+// zones flagged in skip (one flag per ZONE_ROWS rows) are jumped over untested.
+template <typename Test>
+vector<size_t> select_where(const vector<size_t>& rows, Test test, const vector<char>* skip = nullptr) {
+    vector<vector<size_t>> parts(chunk_count(rows.size(), FILTER_GRAIN));
+    parallel_for(rows.size(), FILTER_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        vector<size_t>& out = parts[chunk];
+        out.reserve(end - begin);
+        if (!skip) {
+            for (size_t i = begin; i < end; ++i) {
+                if (test(rows[i])) out.push_back(rows[i]);
+            }
+            return;
+        }
+        for (size_t i = begin; i < end;) {
+            size_t zone = rows[i] / ZONE_ROWS;
+            if ((*skip)[zone]) {
+                i = lower_bound(rows.begin() + i, rows.begin() + end, (zone + 1) * ZONE_ROWS) - rows.begin();
+                continue;
+            }
+            if (test(rows[i])) out.push_back(rows[i]);
+            ++i;
+        }
+    });
+
+    if (parts.size() == 1) return move(parts[0]);
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < parts.size(); ++chunk) total += parts[chunk].size();
+    vector<size_t> selected;
+    selected.reserve(total);
+    for (size_t chunk = 0; chunk < parts.size(); ++chunk) {
+        selected.insert(selected.end(), parts[chunk].begin(), parts[chunk].end());
+    }
+    return selected;
+}
+
+// Rows of the ascending selection that are also index hits (ascending)
+vector<size_t> intersect_hits(const vector<size_t>& hits, const vector<size_t>& rows) {
+    if (rows.size() == dataset.size() - 1) return hits;
+    vector<size_t> selected;
+    vector<size_t>::const_iterator it = rows.begin();
+    for (size_t row : hits) {
+        it = lower_bound(it, rows.end(), row);
+        if (it == rows.end()) break;
+        if (*it == row) selected.push_back(row);
+    }
+    return selected;
+}
+
+// Flags the zones of column whose numbers cannot compare true against x
+vector<char> zone_skips(const NumericColumn& column, CompareOp op, double x) {
+    vector<char> skip(column.zone_min.size());
+    for (size_t zone = 0; zone < skip.size(); ++zone) {
+        const double lo = column.zone_min[zone], hi = column.zone_max[zone];
+        bool possible = false;
+        switch (op) {
+            case CMP_EQ: possible = lo <= x && x <= hi; break;
+            case CMP_NE: possible = lo <= hi && !(lo == x && hi == x); break;
+            case CMP_LT: possible = lo < x; break;
+            case CMP_LE: possible = lo <= x; break;
+            case CMP_GT: possible = hi > x; break;
+            case CMP_GE: possible = hi >= x; break;
+        }
+        skip[zone] = !possible;
+    }
+    return skip;
+}
+
+vector<size_t> compare_numbers(const FilterNode& node, const vector<size_t>& rows) {
+    const double x = node.numbers[0];
+    vector<size_t> hits;
+    if (index_range(node.column, node.compare, x, rows.size() / INDEX_SHARE, hits)) return intersect_hits(hits, rows);
+
+    const NumericColumn& column = numeric_column(node.column);
+    const double* v = column.values.data();
+    vector<char> skip = zone_skips(column, node.compare, x);
+    switch (node.compare) {
+        case CMP_EQ: return select_where(rows, [=](size_t r) { return v[r] == x; }, &skip);
+        case CMP_NE: return select_where(rows, [=](size_t r) { return v[r] != x && v[r] == v[r]; }, &skip);
+        case CMP_LT: return select_where(rows, [=](size_t r) { return v[r] < x; }, &skip);
+        case CMP_LE: return select_where(rows, [=](size_t r) { return v[r] <= x; }, &skip);
+        case CMP_GT: return select_where(rows, [=](size_t r) { return v[r] > x; }, &skip);
+        case CMP_GE: return select_where(rows, [=](size_t r) { return v[r] >= x; }, &skip);
+    }
+    return vector<size_t>();
+}
+
+vector<size_t> compare_texts(const FilterNode& node, const vector<size_t>& rows) {
+    const size_t col = node.column;
+    const string& x = node.texts[0];
+    vector<size_t> hits;
+    if (node.compare == CMP_EQ && index_lookup(col, node.texts, rows.size() / INDEX_SHARE, hits)) {
+        return intersect_hits(hits, rows);
+    }
+
+    auto cell = [col](size_t r) -> const string& { return dataset[r + 1].data[col]; };
+    auto known = [col](size_t r) { return !is_null_value(dataset[r + 1].data[col]); };
+    switch (node.compare) {
+        case CMP_EQ: return select_where(rows, [&](size_t r) { return cell(r) == x && known(r); });
+        case CMP_NE: return select_where(rows, [&](size_t r) { return cell(r) != x && known(r); });
+        case CMP_LT: return select_where(rows, [&](size_t r) { return cell(r) < x && known(r); });
+        case CMP_LE: return select_where(rows, [&](size_t r) { return cell(r) <= x && known(r); });
+        case CMP_GT: return select_where(rows, [&](size_t r) { return cell(r) > x && known(r); });
+        case CMP_GE: return select_where(rows, [&](size_t r) { return cell(r) >= x && known(r); });
+    }
+    return vector<size_t>();
+}
+
+vector<size_t> match_in_list(const FilterNode& node, const vector<size_t>& rows) {
+    const bool negate = node.negate;
+    vector<size_t> hits;
+    if (!negate && !node.numeric && index_lookup(node.column, node.texts, rows.size() / INDEX_SHARE, hits)) {
+        return intersect_hits(hits, rows);
+    }
+    if (node.numeric) {
+        const double* v = numeric_column(node.column).values.data();
+        const vector<double>& list = node.numbers;
+        return select_where(rows, [&](size_t r) {
+            return v[r] == v[r] && (find(list.begin(), list.end(), v[r]) != list.end()) != negate;
+        });
+    }
+
+    const size_t col = node.column;
+    if (node.texts.size() <= SMALL_IN_LIST) {
+        const vector<string>& list = node.texts;
+        return select_where(rows, [&](size_t r) {
+            const string& cell = dataset[r + 1].data[col];
+            return (find(list.begin(), list.end(), cell) != list.end()) != negate && !is_null_value(cell);
+        });
+    }
+    unordered_set<string> set(node.texts.begin(), node.texts.end());
+    return select_where(rows, [&](size_t r) {
+        const string& cell = dataset[r + 1].data[col];
+        return set.count(cell) != negate && !is_null_value(cell);
+    });
+}
+
+// Rows of the selection where leaf node is decided: its cell is not null and,
+// against numeric literals, parsed as a number
+vector<size_t> decided_rows(const FilterNode& node, const vector<size_t>& rows) {
+    if (node.numeric) {
+        const double* v = numeric_column(node.column).values.data();
+        return select_where(rows, [=](size_t r) { return v[r] == v[r]; });
+    }
+    const size_t col = node.column;
+    return select_where(rows, [=](size_t r) { return !is_null_value(dataset[r + 1].data[col]); });
+}
+
+// The rows of the selection for which node is false. As in SQL a leaf on a
+// null cell is neither true nor false, so not (Age > 30) keeps only rows
+// that have an Age; and is false where any part is, or where all parts are.
+vector<size_t> evaluate_false(const FilterNode& node, const vector<size_t>& rows) {
+    switch (node.op) {
+        case FILTER_AND: {
+            // Later branches only see the rows earlier ones did not reject
+            vector<size_t> selected, remaining = rows;
+            for (size_t i = 0; i < node.children.size() && !remaining.empty(); ++i) {
+                vector<size_t> hit = evaluate_false(node.children[i], remaining);
+                vector<size_t> merged, rest;
+                set_union(selected.begin(), selected.end(), hit.begin(), hit.end(), back_inserter(merged));
+                set_difference(remaining.begin(), remaining.end(), hit.begin(), hit.end(), back_inserter(rest));
+                selected.swap(merged);
+                remaining.swap(rest);
+            }
+            return selected;
+        }
+        case FILTER_OR: {
+            vector<size_t> selected = evaluate_false(node.children[0], rows);
+            for (size_t i = 1; i < node.children.size() && !selected.empty(); ++i) {
+                selected = evaluate_false(node.children[i], selected);
+            }
+            return selected;
+        }
+        case FILTER_NOT:
+            return evaluate_filter(node.children[0], rows);
+        case FILTER_IS_NULL: {
+            FilterNode flipped = node;
+            flipped.negate = !node.negate;
+            return evaluate_filter(flipped, rows);
+        }
+        default: {
+            vector<size_t> decided = decided_rows(node, rows), hit = evaluate_filter(node, decided), selected;
+            set_difference(decided.begin(), decided.end(), hit.begin(), hit.end(), back_inserter(selected));
+            return selected;
+        }
+    }
+}
+
+} // namespace
+
+bool parse_filter(const string& expression, FilterNode& root, string& error) {
+    vector<FilterToken> tokens;
+    if (!tokenize_filter(expression, tokens, error)) return false;
+    root = FilterNode();
+    FilterParser parser(tokens, error);
+    return parser.parse(root);
+}
+
+vector<size_t> evaluate_filter(const FilterNode& node, const vector<size_t>& rows) {
+    switch (node.op) {
+        case FILTER_AND: {
+            vector<size_t> selected = evaluate_filter(node.children[0], rows);
+            for (size_t i = 1; i < node.children.size() && !selected.empty(); ++i) {
+                selected = evaluate_filter(node.children[i], selected);
+            }
+            return selected;
+        }
+        case FILTER_OR: {
+            // Later branches only see the rows earlier ones rejected
+            vector<size_t> selected, remaining = rows;
+            for (size_t i = 0; i < node.children.size() && !remaining.empty(); ++i) {
+                vector<size_t> hit = evaluate_filter(node.children[i], remaining);
+                vector<size_t> merged, rest;
+                set_union(selected.begin(), selected.end(), hit.begin(), hit.end(), back_inserter(merged));
+                set_difference(remaining.begin(), remaining.end(), hit.begin(), hit.end(), back_inserter(rest));
+                selected.swap(merged);
+                remaining.swap(rest);
+            }
+            return selected;
+        }
+        case FILTER_NOT:
+            return evaluate_false(node.children[0], rows);
+        case FILTER_IS_NULL: {
+            const size_t col = node.column;
+            const bool negate = node.negate;
+            return select_where(rows, [=](size_t r) { return is_null_value(dataset[r + 1].data[col]) != negate; });
+        }
+        case FILTER_PREFIX: {
+            const size_t col = node.column;
+            const string& prefix = node.texts[0];
+            return select_where(rows, [&](size_t r) {
+                const string& cell = dataset[r + 1].data[col];
+                return cell.compare(0, prefix.size(), prefix) == 0 && !is_null_value(cell);
+            });
+        }
+        case FILTER_IN:
+            return match_in_list(node, rows);
+        case FILTER_COMPARE:
+            return node.numeric ? compare_numbers(node, rows) : compare_texts(node, rows);
+    }
+    return vector<size_t>();
+}
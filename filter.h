@@ -0,0 +1,38 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "main.h"
+
+enum FilterOp { FILTER_AND, FILTER_OR, FILTER_NOT, FILTER_COMPARE, FILTER_IN, FILTER_IS_NULL, FILTER_PREFIX };
+enum CompareOp { CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE };
+
+// Compiled filter expression. Leaves test one column against literals;
+// numeric literals compare the parsed column, text literals compare the
+// cells as strings. Null cells (and non-numeric ones against numbers) are
+// unknown rather than false: they match neither a leaf nor its negation.
+struct FilterNode {
+    FilterOp op = FILTER_COMPARE;
+    vector<FilterNode> children;   // and/or/not
+    size_t column = 0;
+    CompareOp compare = CMP_EQ;
+    bool numeric = false;
+    bool negate = false;           // not in, is not null
+    vector<double> numbers;        // literals when numeric
+    vector<string> texts;          // literals otherwise
+};
+
+// Parses expressions such as
+//   Age > 30 and Region in ('EU', 'US')
+//   not (Score is null or Name startswith 'Tmp')
+// Columns are bare names or `quoted with backticks`, text literals use
+// single quotes; operators: = != <> < <= > >=, in, not in, is [not] null,
+// startswith, combined with and/or/not and parentheses.
+bool parse_filter(const string& expression, FilterNode& root, string& error);
+
+// The rows of the ascending selection rows (0-based data rows) for which
+// node holds, in order. Each leaf is a tight parallel loop over the incoming
+// selection; and narrows the selection, or merges sorted selections, and not
+// selects the rows where its operand is false.
+vector<size_t> evaluate_filter(const FilterNode& node, const vector<size_t>& rows);
+
+#endif // FILTER_H
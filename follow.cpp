@@ -0,0 +1,134 @@
+#include "follow.h"
+#include "columns.h"
+#include "tables.h"
+#include "view.h"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+struct FollowedFile {
+    string filename;
+    string table;            // table the rows go to
+    vector<string> header;   // columns as in the file
+    size_t offset = 0;       // bytes read so far
+    double interval = 0.0;
+    int ticks = 0;
+    int tick = 0;
+    bool following = false;
+    uint64_t version = 0;    // rows_version() after the last append
+    bool warned = false;     // about rounds that reset the maintained results
+};
+
+FollowedFile followed;
+
+// Results kept for the active session, by caller-chosen key
+map<string, unique_ptr<MaintainedState>> maintained;
+
+void stop_following() {
+    followed.following = false;
+    maintained.clear();
+}
+
+// Position of each current column in the file's rows, -1 for columns the
+// script added; columns it dropped are left out
+vector<int> file_columns() {
+    vector<int> source(dataset[0].data.size(), -1);
+    for (size_t col = 0; col < source.size(); ++col) {
+        for (size_t i = 0; i < followed.header.size(); ++i) {
+            if (followed.header[i] == dataset[0].data[col]) source[col] = static_cast<int>(i);
+        }
+    }
+    return source;
+}
+
+} // namespace
+
+void watch_file(const string& filename, const vector<string>& header, size_t offset) {
+    followed.filename = filename;
+    followed.table = active_table();
+    followed.header = header;
+    followed.offset = offset;
+}
+
+bool start_following(double interval_seconds, int ticks, string& error) {
+    if (followed.filename.empty()) {
+        error = "follow needs a file loaded with load_csv first";
+        return false;
+    }
+    followed.interval = max(interval_seconds, 0.0);
+    followed.ticks = max(ticks, 0);
+    followed.tick = 0;
+    followed.following = true;
+    followed.version = rows_version();
+    followed.warned = false;
+    maintained.clear();
+    return true;
+}
+
+bool follow_tick() {
+    if (!followed.following || (followed.ticks > 0 && followed.tick >= followed.ticks)) {
+        stop_following();
+        return false;
+    }
+    followed.tick++;
+    materialize_view();
+    if (rows_version() != followed.version && !followed.warned) {
+        cerr << "Warning: statements after follow() reorder, filter or drop data, so maintained results "
+             << "are recomputed in full every round" << endl;
+        followed.warned = true;
+    }
+    this_thread::sleep_for(chrono::duration<double>(followed.interval));
+
+    // Each round starts from the loaded table, as a re-run script would
+    string error;
+    if (!switch_table(followed.table, error)) {
+        cerr << "Error: " << error << endl;
+        stop_following();
+        return false;
+    }
+
+    ifstream file(followed.filename);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open file " << followed.filename << endl;
+        stop_following();
+        return false;
+    }
+    file.seekg(0, ios::end);
+    size_t size = static_cast<size_t>(file.tellg());
+    if (size < followed.offset) {
+        // Truncated or replaced: read the new file's rows after its header
+        cerr << "Warning: " << followed.filename << " shrank; reading it from the start" << endl;
+        followed.offset = 0;
+    }
+    file.seekg(followed.offset);
+    vector<CSVRow> lines;
+    string header;
+    if (!dataset.empty() && (followed.offset > 0 || (getline(file, header) && !file.eof()))) {
+        if (followed.offset == 0) followed.offset = header.size() + 1;
+        followed.offset += read_csv_rows(file, followed.header.size(), lines, true);
+    }
+
+    vector<int> source = lines.empty() ? vector<int>() : file_columns();
+    vector<CSVRow> rows(lines.size());
+    for (size_t r = 0; r < lines.size(); ++r) {
+        rows[r].data.resize(source.size());
+        for (size_t col = 0; col < source.size(); ++col) {
+            if (source[col] >= 0) rows[r].data[col] = move(lines[r].data[source[col]]);
+        }
+    }
+    size_t added = rows.size();
+    if (added) append_rows(move(rows));
+    followed.version = rows_version();
+    cout << "Tick " << followed.tick << ": appended " << added << " rows from " << followed.filename << " ("
+         << (dataset.empty() ? 0 : dataset.size() - 1) << " rows)" << endl;
+    return true;
+}
+
+unique_ptr<MaintainedState>* maintained_slot(const string& key) {
+    return followed.following ? &maintained[key] : nullptr;
+}
+
+void drop_maintained_state(const string& key) {
+    maintained.erase(key);
+}
@@ -0,0 +1,55 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include "main.h"
+
+#include <memory>
+
+// Follow mode for files that are appended to while they are analysed.
+// load_csv records how far it read its file; follow() makes the statements
+// after it repeat, and before each repeat follow_tick() appends the complete
+// rows written to the file since. Maintained results (column_stats,
+// hash_aggregate, window and detect_anomalies columns) then only process the
+// new rows. The generated program inserts the loop.
+//
+// Appends are the only change a maintained result survives. Statements in
+// the loop that reorder, filter or drop data (sort_data, filter, remove_nulls,
+// drop_column, ...) move every row or renumber the columns, so each round
+// recomputes everything from scratch; follow_tick warns once when that happens.
+
+// Records the file load_csv just read into the active table: its header and
+// the bytes read
+void watch_file(const string& filename, const vector<string>& header, size_t offset);
+
+// Starts following the last loaded file, polling every interval_seconds for
+// ticks rounds (0 for no limit); false with error set when nothing was loaded
+bool start_following(double interval_seconds, int ticks, string& error);
+
+// Waits for the next poll, appends the new rows to the followed table and
+// returns true, or false once the rounds are used up (ending the session)
+bool follow_tick();
+
+// What a maintained result keeps between the rounds of a follow session
+struct MaintainedState {
+    virtual ~MaintainedState() {}
+};
+
+// Slot for the state stored under key, or nullptr when no session is active
+unique_ptr<MaintainedState>* maintained_slot(const string& key);
+
+// Drops the state stored under key, if any
+void drop_maintained_state(const string& key);
+
+// The State kept under key for the active follow session, default-constructed
+// on first use. Outside a session it is nullptr: results are computed from
+// scratch and nothing is kept. Every state is released when the session ends.
+template <typename State>
+State* maintained_state(const string& key) {
+    unique_ptr<MaintainedState>* slot = maintained_slot(key);
+    if (!slot) return nullptr;
+    State* state = dynamic_cast<State*>(slot->get());
+    if (!state) slot->reset(state = new State());
+    return state;
+}
+
+#endif // FOLLOW_H
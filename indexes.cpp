@@ -0,0 +1,143 @@
+#include "indexes.h"
+#include "columns.h"
+#include "sorting.h"
+#include <unordered_map>
+
+namespace {
+
+struct ColumnIndex {
+    IndexKind kind = INDEX_HASH;
+    bool built = false;
+    // Hash: the rows of value id v are rows[offsets[v]] .. rows[offsets[v + 1] - 1]
+    unordered_map<string, uint32_t> ids;
+    vector<size_t> offsets;
+    // Sorted: numbers ascending, keys[i] being the value of data row rows[i]
+    vector<double> keys;
+    vector<size_t> rows;
+};
+
+// Declared indexes by column name, one per column
+map<string, ColumnIndex> indexes;
+
+void build_hash(size_t col, ColumnIndex& index) {
+    DictionaryColumn column = dictionary_column(col);
+    for (size_t id = 0; id < column.values.size(); ++id) {
+        index.ids.insert(make_pair(move(column.values[id]), static_cast<uint32_t>(id)));
+    }
+
+    // Counting sort by id, which keeps the rows of each value ascending
+    index.offsets.assign(column.values.size() + 1, 0);
+    for (uint32_t id : column.ids) index.offsets[id + 1]++;
+    for (size_t id = 0; id < column.values.size(); ++id) index.offsets[id + 1] += index.offsets[id];
+    vector<size_t> next(index.offsets.begin(), index.offsets.end() - 1);
+    index.rows.resize(column.ids.size());
+    for (size_t row = 0; row < column.ids.size(); ++row) index.rows[next[column.ids[row]]++] = row;
+}
+
+void build_sorted(size_t col, ColumnIndex& index) {
+    // Nulls and text sort last and are left out
+    const vector<double>& values = numeric_column(col).values;
+    vector<SortKey> keys(1, SortKey{col, true, false});
+    index.rows = sort_permutation(keys);
+    size_t numbers = 0;
+    while (numbers < index.rows.size() && values[index.rows[numbers]] == values[index.rows[numbers]]) ++numbers;
+    index.rows.resize(numbers);
+    index.keys.resize(numbers);
+    for (size_t i = 0; i < numbers; ++i) index.keys[i] = values[index.rows[i]];
+}
+
+// The index declared on column col, built if needed, or nullptr
+ColumnIndex* find_index(size_t col) {
+    if (dataset.empty() || col >= dataset[0].data.size()) return nullptr;
+    auto it = indexes.find(dataset[0].data[col]);
+    if (it == indexes.end()) return nullptr;
+
+    ColumnIndex& index = it->second;
+    if (!index.built) {
+        if (index.kind == INDEX_HASH) build_hash(col, index);
+        else build_sorted(col, index);
+        index.built = true;
+    }
+    return &index;
+}
+
+} // namespace
+
+bool create_column_index(const string& column, IndexKind kind, string& error) {
+    int col = find_column(column);
+    if (col == -1) {
+        error = "Column not found: " + column;
+        return false;
+    }
+    if (kind == INDEX_SORTED && !is_numeric_column(col)) {
+        error = "A sorted index needs a numeric column: " + column;
+        return false;
+    }
+
+    ColumnIndex& index = indexes[column];
+    index = ColumnIndex();
+    index.kind = kind;
+    find_index(col);
+    return true;
+}
+
+size_t index_size(const string& column) {
+    const ColumnIndex& index = indexes.at(column);
+    return index.kind == INDEX_HASH ? index.ids.size() : index.keys.size();
+}
+
+bool index_lookup(size_t col, const vector<string>& values, size_t max_rows, vector<size_t>& rows) {
+    ColumnIndex* index = find_index(col);
+    if (!index || index->kind != INDEX_HASH) return false;
+
+    vector<uint32_t> hits;
+    size_t total = 0;
+    for (const string& value : values) {
+        auto it = index->ids.find(value);
+        if (it == index->ids.end() || find(hits.begin(), hits.end(), it->second) != hits.end()) continue;
+        hits.push_back(it->second);
+        total += index->offsets[it->second + 1] - index->offsets[it->second];
+    }
+    if (total > max_rows) return false;
+
+    rows.clear();
+    rows.reserve(total);
+    for (uint32_t id : hits) {
+        rows.insert(rows.end(), index->rows.begin() + index->offsets[id], index->rows.begin() + index->offsets[id + 1]);
+    }
+    if (hits.size() > 1) sort(rows.begin(), rows.end());
+    return true;
+}
+
+bool index_range(size_t col, CompareOp op, double x, size_t max_rows, vector<size_t>& rows) {
+    ColumnIndex* index = find_index(col);
+    if (!index || index->kind != INDEX_SORTED) return false;
+
+    const vector<double>& keys = index->keys;
+    vector<double>::const_iterator begin = keys.begin(), end = keys.end();
+    switch (op) {
+        case CMP_EQ:
+            begin = lower_bound(keys.begin(), keys.end(), x);
+            end = upper_bound(begin, keys.end(), x);
+            break;
+        case CMP_LT: end = lower_bound(keys.begin(), keys.end(), x); break;
+        case CMP_LE: end = upper_bound(keys.begin(), keys.end(), x); break;
+        case CMP_GT: begin = upper_bound(keys.begin(), keys.end(), x); break;
+        case CMP_GE: begin = lower_bound(keys.begin(), keys.end(), x); break;
+        case CMP_NE: return false;
+    }
+    if (static_cast<size_t>(end - begin) > max_rows) return false;
+
+    rows.assign(index->rows.begin() + (begin - keys.begin()), index->rows.begin() + (end - keys.begin()));
+    sort(rows.begin(), rows.end());
+    return true;
+}
+
+void invalidate_indexes() {
+    for (auto& entry : indexes) {
+        if (!entry.second.built) continue;
+        IndexKind kind = entry.second.kind;
+        entry.second = ColumnIndex();
+        entry.second.kind = kind;
+    }
+}
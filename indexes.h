@@ -0,0 +1,34 @@
+#ifndef INDEXES_H
+#define INDEXES_H
+
+#include "main.h"
+#include "filter.h"
+
+// Secondary indexes declared with create_index(). A hash index maps each
+// cell of a column to its rows and serves = and in on text literals; a
+// sorted index orders the numbers of a column and serves comparisons with
+// numeric literals. Indexes are dropped whenever the dataset changes and
+// rebuilt on their next use, so a declared index keeps serving filters.
+
+enum IndexKind { INDEX_HASH, INDEX_SORTED };
+
+// Declares an index on column and builds it; false with error set when the
+// column does not exist or a sorted index is asked for on text
+bool create_column_index(const string& column, IndexKind kind, string& error);
+
+// Number of distinct values (hash) or indexed numbers (sorted) of the index
+// on column, which must exist
+size_t index_size(const string& column);
+
+// Rows (ascending) of column col whose cell is one of values. False when
+// col has no hash index or more than max_rows rows would match.
+bool index_lookup(size_t col, const vector<string>& values, size_t max_rows, vector<size_t>& rows);
+
+// Rows (ascending) of column col whose number compares true against x
+// (not !=). False when col has no sorted index or more than max_rows match.
+bool index_range(size_t col, CompareOp op, double x, size_t max_rows, vector<size_t>& rows);
+
+// Drops the built indexes; called by invalidate_columns and reorder_rows
+void invalidate_indexes();
+
+#endif // INDEXES_H
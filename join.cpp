@@ -0,0 +1,224 @@
+#include "join.h"
+#include "parallel.h"
+#include "sketches.h"
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// Rows per chunk for hashing, partitioning and output assembly
+const size_t JOIN_GRAIN = 16384;
+// Target build rows per partition, so its hash table stays in cache
+const size_t PARTITION_ROWS = 1 << 14;
+const int MAX_PARTITION_BITS = 10;
+const size_t NO_ROW = numeric_limits<size_t>::max();
+
+// One side of the join with its key hashed once per row
+struct JoinSide {
+    const vector<CSVRow>* table;
+    size_t key;
+    vector<uint64_t> hashes;
+    vector<char> valid;   // key is not null
+    size_t valid_rows = 0;
+
+    const string& cell(size_t row) const { return (*table)[row + 1].data[key]; }
+};
+
+void hash_side(JoinSide& side) {
+    const size_t rows = side.table->size() - 1;
+    side.hashes.assign(rows, 0);
+    side.valid.assign(rows, 0);
+    vector<size_t> valid(chunk_count(rows, JOIN_GRAIN), 0);
+    parallel_for(rows, JOIN_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (is_null_value(side.cell(i))) continue;
+            side.valid[i] = 1;
+            side.hashes[i] = hash_string(side.cell(i));
+            valid[chunk]++;
+        }
+    });
+    for (size_t chunk = 0; chunk < valid.size(); ++chunk) side.valid_rows += valid[chunk];
+}
+
+// Non-null rows of one side grouped by the top bits of their key hash,
+// keeping row order inside each partition
+struct Partitions {
+    vector<size_t> rows;
+    vector<size_t> offsets;   // partition p is rows[offsets[p], offsets[p + 1])
+};
+
+Partitions partition_side(const JoinSide& side, int bits) {
+    const size_t rows = side.hashes.size();
+    const size_t parts = static_cast<size_t>(1) << bits;
+    auto part_of = [&](size_t i) -> size_t { return bits == 0 ? 0 : side.hashes[i] >> (64 - bits); };
+
+    vector<size_t> next(chunk_count(rows, JOIN_GRAIN) * parts, 0);
+    parallel_for(rows, JOIN_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (side.valid[i]) next[chunk * parts + part_of(i)]++;
+        }
+    });
+
+    // Partition-major prefix sum, chunks in row order within each partition
+    Partitions result;
+    result.offsets.assign(parts + 1, 0);
+    const size_t chunks = next.size() / parts;
+    size_t running = 0;
+    for (size_t p = 0; p < parts; ++p) {
+        result.offsets[p] = running;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            size_t count = next[chunk * parts + p];
+            next[chunk * parts + p] = running;
+            running += count;
+        }
+    }
+    result.offsets[parts] = running;
+
+    result.rows.resize(running);
+    parallel_for(rows, JOIN_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (side.valid[i]) result.rows[next[chunk * parts + part_of(i)]++] = i;
+        }
+    });
+    return result;
+}
+
+} // namespace
+
+bool parse_join_type(const string& name, JoinType& type) {
+    if (name == "inner") type = JOIN_INNER;
+    else if (name == "left") type = JOIN_LEFT;
+    else if (name == "semi") type = JOIN_SEMI;
+    else if (name == "anti") type = JOIN_ANTI;
+    else return false;
+    return true;
+}
+
+vector<CSVRow> hash_join(const vector<CSVRow>& right, size_t left_key, size_t right_key, JoinType type,
+                         JoinStats& stats) {
+    JoinSide left_side, right_side;
+    left_side.table = &dataset;
+    left_side.key = left_key;
+    right_side.table = &right;
+    right_side.key = right_key;
+    hash_side(left_side);
+    hash_side(right_side);
+
+    // Build on the smaller side, with enough partitions to keep each small
+    stats = JoinStats();
+    stats.build_left = left_side.valid_rows < right_side.valid_rows;
+    const JoinSide& build_side = stats.build_left ? left_side : right_side;
+    const JoinSide& probe_side = stats.build_left ? right_side : left_side;
+    int bits = 0;
+    while (bits < MAX_PARTITION_BITS && (build_side.valid_rows >> bits) > PARTITION_ROWS) bits++;
+    stats.partitions = static_cast<size_t>(1) << bits;
+    Partitions build = partition_side(build_side, bits);
+    Partitions probe = partition_side(probe_side, bits);
+
+    const size_t left_rows = left_side.hashes.size();
+    const bool want_pairs = type == JOIN_INNER || type == JOIN_LEFT;
+    vector<vector<pair<size_t, size_t>>> matches(stats.partitions);   // (left row, right row)
+    vector<char> matched(left_rows, 0);
+
+    parallel_for(stats.partitions, 1, [&](size_t, size_t first, size_t last) {
+        for (size_t p = first; p < last; ++p) {
+            const size_t* build_rows = build.rows.data() + build.offsets[p];
+            const size_t build_count = build.offsets[p + 1] - build.offsets[p];
+            if (build_count == 0 || probe.offsets[p + 1] == probe.offsets[p]) continue;
+
+            // Chained table; inserting backwards keeps each chain in row order
+            size_t buckets = 1;
+            while (buckets < build_count) buckets <<= 1;
+            const size_t mask = buckets - 1;
+            vector<size_t> head(buckets, NO_ROW), next(build_count);
+            for (size_t j = build_count; j-- > 0;) {
+                size_t bucket = build_side.hashes[build_rows[j]] & mask;
+                next[j] = head[bucket];
+                head[bucket] = j;
+            }
+
+            for (size_t i = probe.offsets[p]; i < probe.offsets[p + 1]; ++i) {
+                const size_t q = probe.rows[i];
+                const uint64_t hash = probe_side.hashes[q];
+                for (size_t j = head[hash & mask]; j != NO_ROW; j = next[j]) {
+                    const size_t b = build_rows[j];
+                    if (build_side.hashes[b] != hash || build_side.cell(b) != probe_side.cell(q)) continue;
+                    const size_t l = stats.build_left ? b : q;
+                    matched[l] = 1;
+                    if (want_pairs) {
+                        matches[p].push_back(make_pair(l, stats.build_left ? q : b));
+                    } else if (!stats.build_left) {
+                        break;   // semi/anti only need to know a left row matched
+                    }
+                }
+            }
+        }
+    });
+
+    // Order the matches by left row; every left row lives in one partition
+    // and its matches arrive there in right row order
+    vector<size_t> match_offset(left_rows + 1, 0);
+    for (size_t p = 0; p < matches.size(); ++p) {
+        for (size_t m = 0; m < matches[p].size(); ++m) match_offset[matches[p][m].first + 1]++;
+    }
+    for (size_t l = 0; l < left_rows; ++l) match_offset[l + 1] += match_offset[l];
+    vector<size_t> right_rows(match_offset[left_rows]);
+    {
+        vector<size_t> fill(match_offset.begin(), match_offset.end() - 1);
+        for (size_t p = 0; p < matches.size(); ++p) {
+            for (size_t m = 0; m < matches[p].size(); ++m) right_rows[fill[matches[p][m].first]++] = matches[p][m].second;
+        }
+    }
+    matches.clear();
+
+    // Output columns: every left column, then the right ones but its key
+    vector<size_t> right_cols;
+    vector<CSVRow> result(1);
+    result[0].data = dataset[0].data;
+    if (want_pairs) {
+        for (size_t c = 0; c < right[0].data.size(); ++c) {
+            if (c == right_key) continue;
+            const string& name = right[0].data[c];
+            bool clash = find(dataset[0].data.begin(), dataset[0].data.end(), name) != dataset[0].data.end();
+            result[0].data.push_back(clash ? name + "_right" : name);
+            right_cols.push_back(c);
+        }
+    }
+
+    vector<size_t> out_offset(left_rows + 1, 0);
+    for (size_t l = 0; l < left_rows; ++l) {
+        size_t count = match_offset[l + 1] - match_offset[l];
+        size_t rows = type == JOIN_INNER ? count
+                    : type == JOIN_LEFT ? max<size_t>(count, 1)
+                    : type == JOIN_SEMI ? matched[l]
+                    : !matched[l];
+        out_offset[l + 1] = out_offset[l] + rows;
+    }
+    stats.output_rows = out_offset[left_rows];
+    result.resize(stats.output_rows + 1);
+
+    parallel_for(left_rows, JOIN_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t l = begin; l < end; ++l) {
+            size_t out = out_offset[l] + 1;
+            if (out == out_offset[l + 1] + 1) continue;
+            const vector<string>& left_cells = dataset[l + 1].data;
+            if (!want_pairs) {
+                result[out].data = left_cells;
+                continue;
+            }
+            if (match_offset[l] == match_offset[l + 1]) {
+                result[out].data = left_cells;
+                result[out].data.resize(left_cells.size() + right_cols.size());
+                continue;
+            }
+            for (size_t m = match_offset[l]; m < match_offset[l + 1]; ++m, ++out) {
+                const vector<string>& right_cells = right[right_rows[m] + 1].data;
+                vector<string>& cells = result[out].data;
+                cells.reserve(left_cells.size() + right_cols.size());
+                cells = left_cells;
+                for (size_t c = 0; c < right_cols.size(); ++c) cells.push_back(right_cells[right_cols[c]]);
+            }
+        }
+    });
+    return result;
+}
@@ -0,0 +1,26 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include "main.h"
+
+enum JoinType { JOIN_INNER, JOIN_LEFT, JOIN_SEMI, JOIN_ANTI };
+
+// inner, left, semi or anti
+bool parse_join_type(const string& name, JoinType& type);
+
+struct JoinStats {
+    size_t output_rows = 0;
+    size_t partitions = 0;
+    bool build_left = false;   // hash tables were built over the dataset rows
+};
+
+// Joins the dataset (left) with right on dataset[..][left_key] ==
+// right[..][right_key] and returns the joined table, header first, in left
+// row order. Both sides are radix-partitioned on the key hash; each partition
+// builds a chained hash table over the smaller side and probes it with the
+// other, partitions in parallel. Null keys never match. Inner and left joins
+// append the right columns except the key (clashing names get "_right").
+vector<CSVRow> hash_join(const vector<CSVRow>& right, size_t left_key, size_t right_key, JoinType type,
+                         JoinStats& stats);
+
+#endif // JOIN_H
@@ -0,0 +1,725 @@
+#include "kernels.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+namespace {
+
+// Elements reduced in registers before a partial is folded into the compensated total
+const std::size_t BLOCK = 2048;
+// Elements below which a reduction stays on the calling thread
+const std::size_t PARALLEL_GRAIN = 1 << 16;
+
+const double INF = std::numeric_limits<double>::infinity();
+
+// Kahan-Neumaier accumulator for block partials
+struct Compensated {
+    double sum = 0.0;
+    double correction = 0.0;
+
+    void add(double value) {
+        double t = sum + value;
+        if (std::fabs(sum) >= std::fabs(value)) {
+            correction += (sum - t) + value;
+        } else {
+            correction += (value - t) + sum;
+        }
+        sum = t;
+    }
+    double value() const { return sum + correction; }
+};
+
+// Per-ISA kernels over one block of at most BLOCK elements
+struct BlockKernels {
+    const char* name;
+    double (*sum)(const double*, std::size_t, std::size_t*);
+    double (*sq_dev)(const double*, std::size_t, double);
+    void (*min_max)(const double*, std::size_t, double*, double*, std::size_t*);
+    double (*dot)(const double*, const double*, std::size_t);
+    void (*pair_sums)(const double*, const double*, std::size_t, double*, double*, std::size_t*);
+    void (*pair_dev)(const double*, const double*, std::size_t, double, double, double*, double*, double*);
+    void (*affine)(const double*, std::size_t, double, double, double, double*);
+    void (*axpy)(double, const double*, std::size_t, double*);
+    void (*nearest)(const double*, std::size_t, std::size_t, std::size_t, const double*, std::size_t, int*, double*);
+};
+
+// ---- Scalar fallback ----
+
+double sum_scalar(const double* x, std::size_t n, std::size_t* count) {
+    double acc = 0.0;
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i]) {
+            acc += x[i];
+            c++;
+        }
+    }
+    *count = c;
+    return acc;
+}
+
+double sq_dev_scalar(const double* x, std::size_t n, double center) {
+    double acc = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i]) {
+            double d = x[i] - center;
+            acc += d * d;
+        }
+    }
+    return acc;
+}
+
+void min_max_scalar(const double* x, std::size_t n, double* mn, double* mx, std::size_t* count) {
+    double lo = *mn, hi = *mx;
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i]) {
+            lo = std::min(lo, x[i]);
+            hi = std::max(hi, x[i]);
+            c++;
+        }
+    }
+    *mn = lo;
+    *mx = hi;
+    *count += c;
+}
+
+double dot_scalar(const double* x, const double* y, std::size_t n) {
+    double acc = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i] && y[i] == y[i]) acc += x[i] * y[i];
+    }
+    return acc;
+}
+
+void pair_sums_scalar(const double* x, const double* y, std::size_t n,
+                      double* sx, double* sy, std::size_t* count) {
+    double ax = 0.0, ay = 0.0;
+    std::size_t c = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i] && y[i] == y[i]) {
+            ax += x[i];
+            ay += y[i];
+            c++;
+        }
+    }
+    *sx = ax;
+    *sy = ay;
+    *count = c;
+}
+
+void pair_dev_scalar(const double* x, const double* y, std::size_t n, double mx, double my,
+                     double* sxx, double* syy, double* sxy) {
+    double axx = 0.0, ayy = 0.0, axy = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (x[i] == x[i] && y[i] == y[i]) {
+            double dx = x[i] - mx, dy = y[i] - my;
+            axx += dx * dx;
+            ayy += dy * dy;
+            axy += dx * dy;
+        }
+    }
+    *sxx = axx;
+    *syy = ayy;
+    *sxy = axy;
+}
+
+void affine_scalar(const double* x, std::size_t n, double shift, double scale, double offset, double* out) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out[i] = (x[i] - shift) * scale + offset;
+    }
+}
+
+void axpy_scalar(double a, const double* x, std::size_t n, double* y) {
+    for (std::size_t i = 0; i < n; ++i) {
+        y[i] += a * x[i];
+    }
+}
+
+void nearest_scalar(const double* x, std::size_t stride, std::size_t n, std::size_t d,
+                    const double* centroids, std::size_t k, int* labels, double* distances) {
+    for (std::size_t i = 0; i < n; ++i) {
+        double best = INF;
+        int label = 0;
+        for (std::size_t c = 0; c < k; ++c) {
+            double acc = 0.0;
+            for (std::size_t j = 0; j < d; ++j) {
+                double diff = x[j * stride + i] - centroids[c * d + j];
+                acc += diff * diff;
+            }
+            if (acc < best) {
+                best = acc;
+                label = static_cast<int>(c);
+            }
+        }
+        labels[i] = label;
+        distances[i] = best;
+    }
+}
+
+const BlockKernels SCALAR_KERNELS = {
+    "scalar", sum_scalar, sq_dev_scalar, min_max_scalar, dot_scalar,
+    pair_sums_scalar, pair_dev_scalar, affine_scalar, axpy_scalar, nearest_scalar
+};
+
+#ifdef KERNELS_X86
+
+// ---- AVX2 + FMA: 4 doubles per register, two registers per iteration ----
+
+__attribute__((target("avx2,fma")))
+double hsum256(__m256d v) {
+    __m128d lo = _mm256_castpd256_pd128(v);
+    __m128d hi = _mm256_extractf128_pd(v, 1);
+    lo = _mm_add_pd(lo, hi);
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2,fma")))
+std::size_t hcount256(__m256i v) {
+    long long lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), v);
+    return static_cast<std::size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2,fma")))
+double sum_avx2(const double* x, std::size_t n, std::size_t* count) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256i cnt = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a = _mm256_loadu_pd(x + i);
+        __m256d b = _mm256_loadu_pd(x + i + 4);
+        __m256d ma = _mm256_cmp_pd(a, a, _CMP_ORD_Q);
+        __m256d mb = _mm256_cmp_pd(b, b, _CMP_ORD_Q);
+        acc0 = _mm256_add_pd(acc0, _mm256_and_pd(a, ma));
+        acc1 = _mm256_add_pd(acc1, _mm256_and_pd(b, mb));
+        // Ordered lanes are all ones (-1), so subtracting counts them
+        cnt = _mm256_sub_epi64(cnt, _mm256_castpd_si256(ma));
+        cnt = _mm256_sub_epi64(cnt, _mm256_castpd_si256(mb));
+    }
+    std::size_t tail_count;
+    double total = hsum256(_mm256_add_pd(acc0, acc1)) + sum_scalar(x + i, n - i, &tail_count);
+    *count = hcount256(cnt) + tail_count;
+    return total;
+}
+
+__attribute__((target("avx2,fma")))
+double sq_dev_avx2(const double* x, std::size_t n, double center) {
+    __m256d c = _mm256_set1_pd(center);
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a = _mm256_loadu_pd(x + i);
+        __m256d b = _mm256_loadu_pd(x + i + 4);
+        __m256d da = _mm256_and_pd(_mm256_sub_pd(a, c), _mm256_cmp_pd(a, a, _CMP_ORD_Q));
+        __m256d db = _mm256_and_pd(_mm256_sub_pd(b, c), _mm256_cmp_pd(b, b, _CMP_ORD_Q));
+        acc0 = _mm256_fmadd_pd(da, da, acc0);
+        acc1 = _mm256_fmadd_pd(db, db, acc1);
+    }
+    return hsum256(_mm256_add_pd(acc0, acc1)) + sq_dev_scalar(x + i, n - i, center);
+}
+
+__attribute__((target("avx2,fma")))
+void min_max_avx2(const double* x, std::size_t n, double* mn, double* mx, std::size_t* count) {
+    // MINPD/MAXPD return the second operand when the first is NaN
+    __m256d lo = _mm256_set1_pd(*mn), hi = _mm256_set1_pd(*mx);
+    __m256i cnt = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(x + i);
+        lo = _mm256_min_pd(a, lo);
+        hi = _mm256_max_pd(a, hi);
+        cnt = _mm256_sub_epi64(cnt, _mm256_castpd_si256(_mm256_cmp_pd(a, a, _CMP_ORD_Q)));
+    }
+    double lanes_lo[4], lanes_hi[4];
+    _mm256_storeu_pd(lanes_lo, lo);
+    _mm256_storeu_pd(lanes_hi, hi);
+    for (int lane = 0; lane < 4; ++lane) {
+        *mn = std::min(*mn, lanes_lo[lane]);
+        *mx = std::max(*mx, lanes_hi[lane]);
+    }
+    *count += hcount256(cnt);
+    min_max_scalar(x + i, n - i, mn, mx, count);
+}
+
+__attribute__((target("avx2,fma")))
+double dot_avx2(const double* x, const double* y, std::size_t n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a0 = _mm256_loadu_pd(x + i), a1 = _mm256_loadu_pd(x + i + 4);
+        __m256d b0 = _mm256_loadu_pd(y + i), b1 = _mm256_loadu_pd(y + i + 4);
+        __m256d m0 = _mm256_and_pd(_mm256_cmp_pd(a0, a0, _CMP_ORD_Q), _mm256_cmp_pd(b0, b0, _CMP_ORD_Q));
+        __m256d m1 = _mm256_and_pd(_mm256_cmp_pd(a1, a1, _CMP_ORD_Q), _mm256_cmp_pd(b1, b1, _CMP_ORD_Q));
+        acc0 = _mm256_fmadd_pd(_mm256_and_pd(a0, m0), _mm256_and_pd(b0, m0), acc0);
+        acc1 = _mm256_fmadd_pd(_mm256_and_pd(a1, m1), _mm256_and_pd(b1, m1), acc1);
+    }
+    return hsum256(_mm256_add_pd(acc0, acc1)) + dot_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+void pair_sums_avx2(const double* x, const double* y, std::size_t n,
+                    double* sx, double* sy, std::size_t* count) {
+    __m256d ax = _mm256_setzero_pd(), ay = _mm256_setzero_pd();
+    __m256i cnt = _mm256_setzero_si256();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(x + i), b = _mm256_loadu_pd(y + i);
+        __m256d m = _mm256_and_pd(_mm256_cmp_pd(a, a, _CMP_ORD_Q), _mm256_cmp_pd(b, b, _CMP_ORD_Q));
+        ax = _mm256_add_pd(ax, _mm256_and_pd(a, m));
+        ay = _mm256_add_pd(ay, _mm256_and_pd(b, m));
+        cnt = _mm256_sub_epi64(cnt, _mm256_castpd_si256(m));
+    }
+    double tx, ty;
+    std::size_t tc;
+    pair_sums_scalar(x + i, y + i, n - i, &tx, &ty, &tc);
+    *sx = hsum256(ax) + tx;
+    *sy = hsum256(ay) + ty;
+    *count = hcount256(cnt) + tc;
+}
+
+__attribute__((target("avx2,fma")))
+void pair_dev_avx2(const double* x, const double* y, std::size_t n, double mx, double my,
+                   double* sxx, double* syy, double* sxy) {
+    __m256d cx = _mm256_set1_pd(mx), cy = _mm256_set1_pd(my);
+    __m256d axx = _mm256_setzero_pd(), ayy = _mm256_setzero_pd(), axy = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d a = _mm256_loadu_pd(x + i), b = _mm256_loadu_pd(y + i);
+        __m256d m = _mm256_and_pd(_mm256_cmp_pd(a, a, _CMP_ORD_Q), _mm256_cmp_pd(b, b, _CMP_ORD_Q));
+        __m256d dx = _mm256_and_pd(_mm256_sub_pd(a, cx), m);
+        __m256d dy = _mm256_and_pd(_mm256_sub_pd(b, cy), m);
+        axx = _mm256_fmadd_pd(dx, dx, axx);
+        ayy = _mm256_fmadd_pd(dy, dy, ayy);
+        axy = _mm256_fmadd_pd(dx, dy, axy);
+    }
+    double txx, tyy, txy;
+    pair_dev_scalar(x + i, y + i, n - i, mx, my, &txx, &tyy, &txy);
+    *sxx = hsum256(axx) + txx;
+    *syy = hsum256(ayy) + tyy;
+    *sxy = hsum256(axy) + txy;
+}
+
+__attribute__((target("avx2,fma")))
+void affine_avx2(const double* x, std::size_t n, double shift, double scale, double offset, double* out) {
+    __m256d c = _mm256_set1_pd(shift), s = _mm256_set1_pd(scale), o = _mm256_set1_pd(offset);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(_mm256_sub_pd(_mm256_loadu_pd(x + i), c), s, o));
+    }
+    affine_scalar(x + i, n - i, shift, scale, offset, out + i);
+}
+
+__attribute__((target("avx2,fma")))
+void axpy_avx2(double a, const double* x, std::size_t n, double* y) {
+    __m256d s = _mm256_set1_pd(a);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(_mm256_loadu_pd(x + i), s, _mm256_loadu_pd(y + i)));
+    }
+    axpy_scalar(a, x + i, n - i, y + i);
+}
+
+// Four points per register; each centroid's distance is accumulated over
+// the features and the running minimum and its label kept with blends
+__attribute__((target("avx2,fma")))
+void nearest_avx2(const double* x, std::size_t stride, std::size_t n, std::size_t d,
+                  const double* centroids, std::size_t k, int* labels, double* distances) {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d best = _mm256_set1_pd(INF), label = _mm256_setzero_pd();
+        for (std::size_t c = 0; c < k; ++c) {
+            __m256d acc = _mm256_setzero_pd();
+            for (std::size_t j = 0; j < d; ++j) {
+                __m256d diff = _mm256_sub_pd(_mm256_loadu_pd(x + j * stride + i), _mm256_set1_pd(centroids[c * d + j]));
+                acc = _mm256_fmadd_pd(diff, diff, acc);
+            }
+            __m256d closer = _mm256_cmp_pd(acc, best, _CMP_LT_OQ);
+            best = _mm256_blendv_pd(best, acc, closer);
+            label = _mm256_blendv_pd(label, _mm256_set1_pd(static_cast<double>(c)), closer);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(labels + i), _mm256_cvtpd_epi32(label));
+        _mm256_storeu_pd(distances + i, best);
+    }
+    nearest_scalar(x + i, stride, n - i, d, centroids, k, labels + i, distances + i);
+}
+
+const BlockKernels AVX2_KERNELS = {
+    "avx2", sum_avx2, sq_dev_avx2, min_max_avx2, dot_avx2,
+    pair_sums_avx2, pair_dev_avx2, affine_avx2, axpy_avx2, nearest_avx2
+};
+
+// ---- AVX-512: 8 doubles per register, missing lanes handled with mask registers ----
+
+// Horizontal folds go through the 256-bit halves, taken with a full-mask
+// extract into a zeroed register: GCC 12's _mm512_reduce_*, the plain
+// extract and even _mm512_castpd512_pd256 start from an undefined register
+// and trip -Wuninitialized
+__attribute__((target("avx512f")))
+__m256d lower256(__m512d v) {
+    return _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, v, 0);
+}
+
+__attribute__((target("avx512f")))
+__m256d upper256(__m512d v) {
+    return _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, v, 1);
+}
+
+__attribute__((target("avx512f")))
+double hsum512(__m512d v) {
+    return hsum256(_mm256_add_pd(lower256(v), upper256(v)));
+}
+
+__attribute__((target("avx512f")))
+double sum_avx512(const double* x, std::size_t n, std::size_t* count) {
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    std::size_t c = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d a = _mm512_loadu_pd(x + i);
+        __m512d b = _mm512_loadu_pd(x + i + 8);
+        __mmask8 ma = _mm512_cmp_pd_mask(a, a, _CMP_ORD_Q);
+        __mmask8 mb = _mm512_cmp_pd_mask(b, b, _CMP_ORD_Q);
+        acc0 = _mm512_mask_add_pd(acc0, ma, acc0, a);
+        acc1 = _mm512_mask_add_pd(acc1, mb, acc1, b);
+        c += __builtin_popcount(ma) + __builtin_popcount(mb);
+    }
+    std::size_t tail_count;
+    double total = hsum512(_mm512_add_pd(acc0, acc1)) + sum_scalar(x + i, n - i, &tail_count);
+    *count = c + tail_count;
+    return total;
+}
+
+__attribute__((target("avx512f")))
+double sq_dev_avx512(const double* x, std::size_t n, double center) {
+    __m512d c = _mm512_set1_pd(center);
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d a = _mm512_loadu_pd(x + i);
+        __m512d b = _mm512_loadu_pd(x + i + 8);
+        __m512d da = _mm512_maskz_sub_pd(_mm512_cmp_pd_mask(a, a, _CMP_ORD_Q), a, c);
+        __m512d db = _mm512_maskz_sub_pd(_mm512_cmp_pd_mask(b, b, _CMP_ORD_Q), b, c);
+        acc0 = _mm512_fmadd_pd(da, da, acc0);
+        acc1 = _mm512_fmadd_pd(db, db, acc1);
+    }
+    return hsum512(_mm512_add_pd(acc0, acc1)) + sq_dev_scalar(x + i, n - i, center);
+}
+
+__attribute__((target("avx512f")))
+void min_max_avx512(const double* x, std::size_t n, double* mn, double* mx, std::size_t* count) {
+    __m512d lo = _mm512_set1_pd(*mn), hi = _mm512_set1_pd(*mx);
+    std::size_t c = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d a = _mm512_loadu_pd(x + i);
+        __mmask8 m = _mm512_cmp_pd_mask(a, a, _CMP_ORD_Q);
+        lo = _mm512_mask_min_pd(lo, m, lo, a);
+        hi = _mm512_mask_max_pd(hi, m, hi, a);
+        c += __builtin_popcount(m);
+    }
+    double lanes_lo[4], lanes_hi[4];
+    _mm256_storeu_pd(lanes_lo, _mm256_min_pd(lower256(lo), upper256(lo)));
+    _mm256_storeu_pd(lanes_hi, _mm256_max_pd(lower256(hi), upper256(hi)));
+    for (int lane = 0; lane < 4; ++lane) {
+        *mn = std::min(*mn, lanes_lo[lane]);
+        *mx = std::max(*mx, lanes_hi[lane]);
+    }
+    *count += c;
+    min_max_scalar(x + i, n - i, mn, mx, count);
+}
+
+__attribute__((target("avx512f")))
+double dot_avx512(const double* x, const double* y, std::size_t n) {
+    __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d a0 = _mm512_loadu_pd(x + i), a1 = _mm512_loadu_pd(x + i + 8);
+        __m512d b0 = _mm512_loadu_pd(y + i), b1 = _mm512_loadu_pd(y + i + 8);
+        __mmask8 m0 = _mm512_cmp_pd_mask(a0, a0, _CMP_ORD_Q) & _mm512_cmp_pd_mask(b0, b0, _CMP_ORD_Q);
+        __mmask8 m1 = _mm512_cmp_pd_mask(a1, a1, _CMP_ORD_Q) & _mm512_cmp_pd_mask(b1, b1, _CMP_ORD_Q);
+        acc0 = _mm512_mask3_fmadd_pd(a0, b0, acc0, m0);
+        acc1 = _mm512_mask3_fmadd_pd(a1, b1, acc1, m1);
+    }
+    return hsum512(_mm512_add_pd(acc0, acc1)) + dot_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+void pair_sums_avx512(const double* x, const double* y, std::size_t n,
+                      double* sx, double* sy, std::size_t* count) {
+    __m512d ax = _mm512_setzero_pd(), ay = _mm512_setzero_pd();
+    std::size_t c = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d a = _mm512_loadu_pd(x + i), b = _mm512_loadu_pd(y + i);
+        __mmask8 m = _mm512_cmp_pd_mask(a, a, _CMP_ORD_Q) & _mm512_cmp_pd_mask(b, b, _CMP_ORD_Q);
+        ax = _mm512_mask_add_pd(ax, m, ax, a);
+        ay = _mm512_mask_add_pd(ay, m, ay, b);
+        c += __builtin_popcount(m);
+    }
+    double tx, ty;
+    std::size_t tc;
+    pair_sums_scalar(x + i, y + i, n - i, &tx, &ty, &tc);
+    *sx = hsum512(ax) + tx;
+    *sy = hsum512(ay) + ty;
+    *count = c + tc;
+}
+
+__attribute__((target("avx512f")))
+void pair_dev_avx512(const double* x, const double* y, std::size_t n, double mx, double my,
+                     double* sxx, double* syy, double* sxy) {
+    __m512d cx = _mm512_set1_pd(mx), cy = _mm512_set1_pd(my);
+    __m512d axx = _mm512_setzero_pd(), ayy = _mm512_setzero_pd(), axy = _mm512_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d a = _mm512_loadu_pd(x + i), b = _mm512_loadu_pd(y + i);
+        __mmask8 m = _mm512_cmp_pd_mask(a, a, _CMP_ORD_Q) & _mm512_cmp_pd_mask(b, b, _CMP_ORD_Q);
+        __m512d dx = _mm512_maskz_sub_pd(m, a, cx);
+        __m512d dy = _mm512_maskz_sub_pd(m, b, cy);
+        axx = _mm512_fmadd_pd(dx, dx, axx);
+        ayy = _mm512_fmadd_pd(dy, dy, ayy);
+        axy = _mm512_fmadd_pd(dx, dy, axy);
+    }
+    double txx, tyy, txy;
+    pair_dev_scalar(x + i, y + i, n - i, mx, my, &txx, &tyy, &txy);
+    *sxx = hsum512(axx) + txx;
+    *syy = hsum512(ayy) + tyy;
+    *sxy = hsum512(axy) + txy;
+}
+
+__attribute__((target("avx512f")))
+void affine_avx512(const double* x, std::size_t n, double shift, double scale, double offset, double* out) {
+    __m512d c = _mm512_set1_pd(shift), s = _mm512_set1_pd(scale), o = _mm512_set1_pd(offset);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(out + i, _mm512_fmadd_pd(_mm512_sub_pd(_mm512_loadu_pd(x + i), c), s, o));
+    }
+    affine_scalar(x + i, n - i, shift, scale, offset, out + i);
+}
+
+__attribute__((target("avx512f")))
+void axpy_avx512(double a, const double* x, std::size_t n, double* y) {
+    __m512d s = _mm512_set1_pd(a);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(_mm512_loadu_pd(x + i), s, _mm512_loadu_pd(y + i)));
+    }
+    axpy_scalar(a, x + i, n - i, y + i);
+}
+
+__attribute__((target("avx512f")))
+void nearest_avx512(const double* x, std::size_t stride, std::size_t n, std::size_t d,
+                    const double* centroids, std::size_t k, int* labels, double* distances) {
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512d best = _mm512_set1_pd(INF), label = _mm512_setzero_pd();
+        for (std::size_t c = 0; c < k; ++c) {
+            __m512d acc = _mm512_setzero_pd();
+            for (std::size_t j = 0; j < d; ++j) {
+                __m512d diff = _mm512_sub_pd(_mm512_loadu_pd(x + j * stride + i), _mm512_set1_pd(centroids[c * d + j]));
+                acc = _mm512_fmadd_pd(diff, diff, acc);
+            }
+            __mmask8 closer = _mm512_cmp_pd_mask(acc, best, _CMP_LT_OQ);
+            best = _mm512_mask_mov_pd(best, closer, acc);
+            label = _mm512_mask_mov_pd(label, closer, _mm512_set1_pd(static_cast<double>(c)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(labels + i), _mm256_cvtpd_epi32(lower256(label)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(labels + i + 4), _mm256_cvtpd_epi32(upper256(label)));
+        _mm512_storeu_pd(distances + i, best);
+    }
+    nearest_scalar(x + i, stride, n - i, d, centroids, k, labels + i, distances + i);
+}
+
+const BlockKernels AVX512_KERNELS = {
+    "avx512", sum_avx512, sq_dev_avx512, min_max_avx512, dot_avx512,
+    pair_sums_avx512, pair_dev_avx512, affine_avx512, axpy_avx512, nearest_avx512
+};
+
+#endif // KERNELS_X86
+
+const BlockKernels& select_kernels() {
+    const char* forced = std::getenv("CSV_KERNELS");
+    std::string choice = forced ? forced : "";
+    if (choice == "scalar") return SCALAR_KERNELS;
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    bool has_avx512 = __builtin_cpu_supports("avx512f");
+    bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (choice == "avx2" && has_avx2) return AVX2_KERNELS;
+    if (has_avx512 && choice != "avx2") return AVX512_KERNELS;
+    if (has_avx2) return AVX2_KERNELS;
+#endif
+    return SCALAR_KERNELS;
+}
+
+const BlockKernels& kernels() {
+    static const BlockKernels& selected = select_kernels();
+    return selected;
+}
+
+// Runs body(chunk, begin, length) for every block of [0, n), chunks in parallel
+template <typename Body>
+void for_each_block(std::size_t n, Body body) {
+    parallel_for(n, PARALLEL_GRAIN, [&](std::size_t chunk, std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i += BLOCK) {
+            body(chunk, i, std::min(BLOCK, end - i));
+        }
+    });
+}
+
+} // namespace
+
+SumResult kernel_sum(const double* x, std::size_t n) {
+    const BlockKernels& k = kernels();
+    std::size_t chunks = chunk_count(n, PARALLEL_GRAIN);
+    std::vector<Compensated> sums(chunks);
+    std::vector<std::size_t> counts(chunks, 0);
+
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        std::size_t count;
+        sums[chunk].add(k.sum(x + begin, length, &count));
+        counts[chunk] += count;
+    });
+
+    Compensated total;
+    SumResult result = {0.0, 0};
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        total.add(sums[chunk].sum);
+        total.add(sums[chunk].correction);
+        result.count += counts[chunk];
+    }
+    result.sum = total.value();
+    return result;
+}
+
+double kernel_sum_sq_dev(const double* x, std::size_t n, double center) {
+    const BlockKernels& k = kernels();
+    std::vector<Compensated> sums(chunk_count(n, PARALLEL_GRAIN));
+
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        sums[chunk].add(k.sq_dev(x + begin, length, center));
+    });
+
+    Compensated total;
+    for (const Compensated& part : sums) {
+        total.add(part.sum);
+        total.add(part.correction);
+    }
+    return total.value();
+}
+
+MinMaxResult kernel_min_max(const double* x, std::size_t n) {
+    const BlockKernels& k = kernels();
+    std::size_t chunks = chunk_count(n, PARALLEL_GRAIN);
+    std::vector<MinMaxResult> parts(chunks, MinMaxResult{INF, -INF, 0});
+
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        k.min_max(x + begin, length, &parts[chunk].min, &parts[chunk].max, &parts[chunk].count);
+    });
+
+    MinMaxResult result = {INF, -INF, 0};
+    for (const MinMaxResult& part : parts) {
+        result.min = std::min(result.min, part.min);
+        result.max = std::max(result.max, part.max);
+        result.count += part.count;
+    }
+    return result;
+}
+
+double kernel_dot(const double* x, const double* y, std::size_t n) {
+    const BlockKernels& k = kernels();
+    std::vector<Compensated> sums(chunk_count(n, PARALLEL_GRAIN));
+
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        sums[chunk].add(k.dot(x + begin, y + begin, length));
+    });
+
+    Compensated total;
+    for (const Compensated& part : sums) {
+        total.add(part.sum);
+        total.add(part.correction);
+    }
+    return total.value();
+}
+
+CoMoments kernel_co_moments(const double* x, const double* y, std::size_t n) {
+    const BlockKernels& k = kernels();
+    std::size_t chunks = chunk_count(n, PARALLEL_GRAIN);
+    CoMoments result = {0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+    // Pass 1: means over rows where both values are present
+    std::vector<Compensated> sx(chunks), sy(chunks);
+    std::vector<std::size_t> counts(chunks, 0);
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        double bx, by;
+        std::size_t count;
+        k.pair_sums(x + begin, y + begin, length, &bx, &by, &count);
+        sx[chunk].add(bx);
+        sy[chunk].add(by);
+        counts[chunk] += count;
+    });
+
+    Compensated total_x, total_y;
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        total_x.add(sx[chunk].value());
+        total_y.add(sy[chunk].value());
+        result.count += counts[chunk];
+    }
+    if (result.count == 0) return result;
+    result.mean_x = total_x.value() / result.count;
+    result.mean_y = total_y.value() / result.count;
+
+    // Pass 2: centred products, which avoids the cancellation of raw sums of squares
+    std::vector<Compensated> sxx(chunks), syy(chunks), sxy(chunks);
+    for_each_block(n, [&](std::size_t chunk, std::size_t begin, std::size_t length) {
+        double bxx, byy, bxy;
+        k.pair_dev(x + begin, y + begin, length, result.mean_x, result.mean_y, &bxx, &byy, &bxy);
+        sxx[chunk].add(bxx);
+        syy[chunk].add(byy);
+        sxy[chunk].add(bxy);
+    });
+
+    Compensated txx, tyy, txy;
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        txx.add(sxx[chunk].value());
+        tyy.add(syy[chunk].value());
+        txy.add(sxy[chunk].value());
+    }
+    result.sxx = txx.value();
+    result.syy = tyy.value();
+    result.sxy = txy.value();
+    return result;
+}
+
+void kernel_affine(const double* x, std::size_t n, double shift, double scale, double offset, double* out) {
+    const BlockKernels& k = kernels();
+    for_each_block(n, [&](std::size_t, std::size_t begin, std::size_t length) {
+        k.affine(x + begin, length, shift, scale, offset, out + begin);
+    });
+}
+
+void kernel_axpy(double a, const double* x, std::size_t n, double* y) {
+    const BlockKernels& k = kernels();
+    for_each_block(n, [&](std::size_t, std::size_t begin, std::size_t length) {
+        k.axpy(a, x + begin, length, y + begin);
+    });
+}
+
+void kernel_nearest(const double* x, std::size_t stride, std::size_t n, std::size_t d,
+                    const double* centroids, std::size_t clusters, int* labels, double* distances) {
+    const BlockKernels& k = kernels();
+    for_each_block(n, [&](std::size_t, std::size_t begin, std::size_t length) {
+        k.nearest(x + begin, stride, length, d, centroids, clusters, labels + begin, distances + begin);
+    });
+}
+
+const char* kernel_isa() {
+    return kernels().name;
+}
@@ -0,0 +1,53 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+// Vectorised reductions over contiguous doubles. NaN entries mark missing
+// cells and are skipped (pairwise kernels skip a row when either side is
+// missing). The instruction set is picked once at runtime: AVX-512, AVX2+FMA
+// or scalar; setting CSV_KERNELS=scalar|avx2|avx512 overrides the choice.
+// Sums are taken over fixed-size blocks whose partials are combined with
+// Kahan-Neumaier compensation, and long inputs are split across threads.
+
+struct SumResult {
+    double sum;
+    std::size_t count;
+};
+
+struct MinMaxResult {
+    double min;
+    double max;
+    std::size_t count;
+};
+
+// Means and centred second moments over the rows where both inputs are present
+struct CoMoments {
+    std::size_t count;
+    double mean_x, mean_y;
+    double sxx, syy, sxy;
+};
+
+SumResult kernel_sum(const double* x, std::size_t n);
+double kernel_sum_sq_dev(const double* x, std::size_t n, double center);  // sum of (x - center)^2
+MinMaxResult kernel_min_max(const double* x, std::size_t n);
+double kernel_dot(const double* x, const double* y, std::size_t n);
+CoMoments kernel_co_moments(const double* x, const double* y, std::size_t n);
+
+// out[i] = (x[i] - shift) * scale + offset, so x == shift maps exactly to
+// offset on every instruction set; missing entries stay NaN. out may alias x.
+void kernel_affine(const double* x, std::size_t n, double shift, double scale, double offset, double* out);
+
+// y[i] += a * x[i], with no missing-value handling
+void kernel_axpy(double a, const double* x, std::size_t n, double* y);
+
+// Nearest of clusters centroids (row-major, d values each) for n points
+// stored feature-major: feature j of point i is x[j * stride + i]. Writes
+// the centroid index (the lowest on ties) and the squared distance to it.
+void kernel_nearest(const double* x, std::size_t stride, std::size_t n, std::size_t d,
+                    const double* centroids, std::size_t clusters, int* labels, double* distances);
+
+// Name of the instruction set the kernels dispatched to
+const char* kernel_isa();
+
+#endif // KERNELS_H
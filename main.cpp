@@ -1,5 +1,26 @@
 #include "main.h"
 #include "tokenizer_parser.h"
+#include "stats_engine.h"
+#include "columns.h"
+#include "kernels.h"
+#include "sorting.h"
+#include "external_sort.h"
+#include "aggregation.h"
+#include "tables.h"
+#include "join.h"
+#include "filter.h"
+#include "view.h"
+#include "indexes.h"
+#include "window_functions.h"
+#include "timestamps.h"
+#include "seasonal.h"
+#include "anomalies.h"
+#include "follow.h"
+#include "models.h"
+#include "sgd.h"
+#include "validation.h"
+#include "clustering.h"
+#include "parallel.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -10,12 +31,20 @@
 #include <algorithm>
 #include <cmath>
 #include <regex>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <random>
+#include <limits>
+#include <chrono>
 
 using namespace std;
 
 // Global data storage
 vector<CSVRow> dataset;
-double model_slope = 0.0, model_intercept = 0.0;
+double quantile_epsilon = 0.01;
+int max_display_values = 20;
+size_t sort_memory_limit = 256u << 20;
 
 // Helper functions
 void tokenize_column(const string& text_column) {
@@ -44,29 +73,97 @@ double safe_stod(const string& s) {
     }
 }
 
-// Additional functions that were missing
-void remove_nulls() {
-    vector<CSVRow> cleaned;
+bool is_null_value(const string& s) {
+    return s.empty() || s == "null" || s == "NA" || s == "NaN";
+}
+
+// Exception-free replacement for stod that accepts only a whole cell: a number
+// with optional surrounding whitespace, so "12abc" or "2024-01-05" are text.
+// Short decimals take an exact fast path (mantissa below 2^53, |exponent| <= 22);
+// everything else falls back to strtod.
+bool parse_double(const string& s, double& value) {
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = s.c_str();
+    const char* end = p + s.size();
+    while (p < end && isspace(static_cast<unsigned char>(*p))) p++;
+    const char* start = p;
+    auto rest_is_space = [end](const char* q) {
+        while (q < end && isspace(static_cast<unsigned char>(*q))) q++;
+        return q == end;
+    };
 
-    if (!dataset.empty()) {
-        cleaned.push_back(dataset[0]);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
     }
 
-    for (size_t i = 1; i < dataset.size(); i++) {
-        bool hasNull = false;
-        for (const auto& cell : dataset[i].data) {
-            if (cell.empty() || cell == "null" || cell == "NA" || cell == "NaN") {
-                hasNull = true;
-                break;
-            }
+    uint64_t mantissa = 0;
+    int significant = 0, exponent = 0, digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) significant++;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) significant++;
+            exponent--;
         }
-        if (!hasNull) {
-            cleaned.push_back(dataset[i]);
+    }
+    if (p < end && (*p == 'e' || *p == 'E') && digits > 0) {
+        const char* q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
         }
+        int exp_value = 0;
+        const char* exp_start = q;
+        for (; q < end && *q >= '0' && *q <= '9' && exp_value < 10000; q++) {
+            exp_value = exp_value * 10 + (*q - '0');
+        }
+        if (q > exp_start) {
+            exponent += exp_negative ? -exp_value : exp_value;
+            p = q;
+        }
+    }
+
+    if (digits > 0 && significant <= 15 && exponent >= -22 && exponent <= 22 && rest_is_space(p)) {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / powers_of_ten[-exponent] : result * powers_of_ten[exponent];
+        value = negative ? -result : result;
+        return true;
     }
 
-    int removed = dataset.size() - cleaned.size();
-    dataset = cleaned;
+    // Long mantissas, large exponents, inf/nan and hex floats
+    char* parsed_end = nullptr;
+    double result = strtod(start, &parsed_end);
+    if (parsed_end == start || !rest_is_space(parsed_end)) return false;
+    value = result;
+    return true;
+}
+
+// Additional functions that were missing
+void remove_nulls() {
+    // Narrows the view one column at a time; nothing is copied
+    vector<size_t> rows = view_rows();
+    size_t before = rows.size();
+    FilterNode not_null;
+    not_null.op = FILTER_IS_NULL;
+    not_null.negate = true;
+    for (size_t col : view_columns()) {
+        if (rows.empty()) break;
+        not_null.column = col;
+        rows = evaluate_filter(not_null, rows);
+    }
+
+    size_t removed = before - rows.size();
+    select_view_rows(move(rows));
     cout << "Removed " << removed << " rows containing null values" << endl;
 }
 
@@ -81,42 +178,22 @@ void describe_data() {
     cout << "Number of columns: " << dataset[0].data.size() << endl;
     cout << "\nColumns:" << endl;
 
-    for (size_t col = 0; col < dataset[0].data.size(); col++) {
-        cout << "\n" << dataset[0].data[col] << ":" << endl;
-
-        vector<double> numeric_values;
-        bool is_numeric = true;
-
-        for (size_t row = 1; row < dataset.size(); row++) {
-            try {
-                numeric_values.push_back(stod(dataset[row].data[col]));
-            } catch (...) {
-                is_numeric = false;
-                break;
-            }
-        }
-
-        if (is_numeric && !numeric_values.empty()) {
-            double sum = accumulate(numeric_values.begin(), numeric_values.end(), 0.0);
-            double mean = sum / numeric_values.size();
-
-            sort(numeric_values.begin(), numeric_values.end());
-            double median = numeric_values[numeric_values.size() / 2];
-            double min = numeric_values.front();
-            double max = numeric_values.back();
+    for (const ColumnProfile& profile : profile_columns()) {
+        cout << "\n" << profile.name << ":" << endl;
 
+        if (profile.numeric) {
             cout << "  Type: Numeric" << endl;
-            cout << "  Mean: " << mean << endl;
-            cout << "  Median: " << median << endl;
-            cout << "  Min: " << min << endl;
-            cout << "  Max: " << max << endl;
+            cout << "  Mean: " << profile.stats.mean << endl;
+            cout << "  Median: " << profile.median << endl;
+            cout << "  Min: " << profile.stats.min << endl;
+            cout << "  Max: " << profile.stats.max << endl;
         } else {
-            set<string> unique_values;
-            for (size_t row = 1; row < dataset.size(); row++) {
-                unique_values.insert(dataset[row].data[col]);
-            }
             cout << "  Type: Categorical" << endl;
-            cout << "  Unique values: " << unique_values.size() << endl;
+            cout << "  Unique values: " << (profile.distinct_exact ? "" : "~")
+                 << static_cast<size_t>(profile.distinct + 0.5) << endl;
+        }
+        if (profile.nulls > 0) {
+            cout << "  Nulls: " << profile.nulls << endl;
         }
     }
 }
@@ -129,6 +206,7 @@ void fill_nulls(const string& value) {
             }
         }
     }
+    invalidate_columns();
     cout << "Filled null values with " << value << endl;
 }
 
@@ -200,64 +278,368 @@ void plot(const string& col1, const string& col2) {
     cout << "Plot generated as plot.png" << endl;
 }
 
-void train_model(const string& feature, const string& target) {
-    cout << "Training model with feature: " << feature << " and target: " << target << endl;
-    
-    // Find column indices
-    int feature_idx = -1, target_idx = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); i++) {
-        if (dataset[0].data[i] == feature) feature_idx = i;
-        if (dataset[0].data[i] == target) target_idx = i;
+// Feature columns of model, or false with an error printed
+bool model_features(const Model& model, vector<size_t>& features) {
+    if (!model.trained()) {
+        cerr << "Error: No trained model found. Please train the model first." << endl;
+        return false;
+    }
+    features.clear();
+    for (const string& name : model.features) {
+        int col = find_column(name);
+        if (col == -1) {
+            cerr << "Error: Model column " << name << " not found" << endl;
+            return false;
+        }
+        features.push_back(col);
+    }
+    return true;
+}
+
+// Feature and target columns of model, or false with an error printed
+bool model_columns(const Model& model, vector<size_t>& features, size_t& target) {
+    if (!model_features(model, features)) return false;
+    int col = find_column(model.target);
+    if (col == -1) {
+        cerr << "Error: Model column " << model.target << " not found" << endl;
+        return false;
     }
+    target = col;
+    return true;
+}
 
-    if (feature_idx == -1 || target_idx == -1) {
-        cerr << "Error: Feature or target column not found" << endl;
+// Rows of partition where every one of cols is a number, or false with an
+// error printed
+bool partition_complete_rows(const string& partition, const vector<size_t>& cols, vector<size_t>& rows) {
+    string error;
+    if (!partition_rows(partition, rows, error)) {
+        cerr << "Error: " << error << endl;
+        return false;
+    }
+    rows = complete_rows(rows, cols);
+    return true;
+}
+
+// Prints how an SGD fit went
+void print_sgd_report(const Model& model, const SgdReport& report) {
+    const char* loss = model.logistic() ? "log-loss" : "MSE";
+    cout << "SGD ran " << report.epochs << " epochs" << (report.stopped_early ? " (stopped early)" : "")
+         << ", keeping epoch " << report.best_epoch << ": training " << loss << " " << report.train_loss;
+    if (report.holdout_rows) cout << ", validation " << loss << " " << report.validation_loss << " on "
+                                  << report.holdout_rows << " held-out rows";
+    cout << endl;
+}
+
+// Prints the equation of a freshly trained model
+void print_model(const Model& model) {
+    cout << "Model trained successfully on " << model.rows << " rows" << endl;
+    cout << "Equation: " << (model.logistic() ? "logit(P(" + model.target + " = 1))" : model.target) << " = "
+         << model.intercept;
+    for (size_t i = 0; i < model.features.size(); ++i) {
+        cout << (model.weights[i] < 0 ? " - " : " + ") << fabs(model.weights[i]) << " * " << model.features[i];
+    }
+    cout << endl;
+}
+
+void train_model(const string& features, const string& target, const string& partition, double alpha,
+                 const string& method) {
+    cout << "Training model with features: " << features << " and target: " << target;
+    if (partition != "all") cout << " on partition " << partition;
+    if (alpha > 0) cout << " (" << (method == "normal" ? "ridge" : "L2") << " alpha " << alpha << ")";
+    if (method != "normal") cout << " by " << method;
+    cout << endl;
+
+    vector<size_t> feature_cols;
+    string error;
+    int target_idx = find_column(target);
+    if (!find_columns(features, feature_cols, error) || target_idx == -1) {
+        cerr << "Error: " << (target_idx == -1 ? "Column not found: " + target : error) << endl;
+        return;
+    }
+    if (feature_cols.empty() || alpha < 0) {
+        cerr << "Error: Training needs at least one feature and a non-negative alpha" << endl;
+        return;
+    }
+    if (method != "normal" && method != "sgd" && method != "logistic") {
+        cerr << "Error: Unknown training method " << method << " (use normal, sgd or logistic)" << endl;
         return;
     }
 
-    vector<double> X, Y;
-    for (size_t i = 1; i < dataset.size(); i++) {
-        try {
-            X.push_back(stod(dataset[i].data[feature_idx]));
-            Y.push_back(stod(dataset[i].data[target_idx]));
-        } catch (...) {
+    vector<size_t> cols(feature_cols);
+    cols.push_back(target_idx);
+    vector<size_t> rows;
+    if (!partition_complete_rows(partition, cols, rows)) return;
+
+    Model model;
+    SgdReport report;
+    bool trained = method == "normal"
+        ? fit_linear(feature_cols, target_idx, rows, alpha, model, error)
+        : fit_sgd(feature_cols, target_idx, rows, alpha, method == "logistic", sgd_settings, model, report, error);
+    if (!trained) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    current_model = model;
+
+    if (method != "normal") print_sgd_report(model, report);
+    print_model(model);
+}
+
+void train_model() {
+    if (!current_model.trained()) {
+        cerr << "Error: No trained model found. Please train the model first." << endl;
+        return;
+    }
+    string features;
+    for (size_t i = 0; i < current_model.features.size(); ++i) features += (i ? "," : "") + current_model.features[i];
+    train_model(features, current_model.target, "all", current_model.alpha, current_model.method);
+}
+
+void train_model_csv(const string& filename, const string& features, const string& target, const string& method,
+                     double alpha) {
+    cout << "Training model from " << filename << " with features: " << features << " and target: " << target
+         << " by " << method << endl;
+    if (method != "sgd" && method != "logistic") {
+        cerr << "Error: Training from a file needs method sgd or logistic" << endl;
+        return;
+    }
+    vector<string> names = split_list(features);
+    if (names.empty() || alpha < 0) {
+        cerr << "Error: Training needs at least one feature and a non-negative alpha" << endl;
+        return;
+    }
+
+    Model model;
+    SgdReport report;
+    string error;
+    if (!fit_sgd_csv(filename, names, target, alpha, method == "logistic", sgd_settings, model, report, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    current_model = model;
+    print_sgd_report(model, report);
+    print_model(model);
+}
+
+void sgd_options(double learning_rate, int epochs, int batch_size, int patience, double validation) {
+    if (!(learning_rate > 0) || epochs <= 0 || batch_size <= 0 || patience <= 0 ||
+        !(validation >= 0 && validation < 1)) {
+        cerr << "Error: SGD needs a positive learning rate, epochs, batch size and patience, "
+                "and a validation fraction in [0, 1)" << endl;
+        return;
+    }
+    sgd_settings.learning_rate = learning_rate;
+    sgd_settings.epochs = epochs;
+    sgd_settings.batch_size = batch_size;
+    sgd_settings.patience = patience;
+    sgd_settings.validation = validation;
+    cout << "SGD options: learning rate " << learning_rate << ", " << epochs << " epochs, batches of "
+         << batch_size << ", patience " << patience << ", validation fraction " << validation << endl;
+}
+
+// Training spec of the current model and its complete rows in partition,
+// or false with an error printed
+bool current_model_spec(const string& partition, TrainingSpec& spec, vector<size_t>& rows) {
+    if (!model_columns(current_model, spec.features, spec.target)) return false;
+    spec.method = current_model.method;
+    spec.alpha = current_model.alpha;
+    spec.sgd = sgd_settings;
+    vector<size_t> cols(spec.features);
+    cols.push_back(spec.target);
+    return partition_complete_rows(partition, cols, rows);
+}
+
+// Mean and standard deviation over the successful folds of the fold loss
+// and of the second metric (R-squared or accuracy)
+struct FoldSummary {
+    RunningStats loss, score;
+    double seconds = 0.0;
+    size_t failed = 0;
+    string error;
+};
+
+FoldSummary summarize_folds(const vector<FoldResult>& folds, bool logistic) {
+    FoldSummary summary;
+    for (const FoldResult& fold : folds) {
+        summary.seconds += fold.seconds;
+        if (!fold.ok) {
+            summary.failed++;
+            summary.error = fold.error;
             continue;
         }
+        summary.loss.add(logistic ? fold.metrics.log_loss : fold.metrics.mse);
+        summary.score.add(logistic ? fold.metrics.accuracy : fold.metrics.r_squared);
     }
+    return summary;
+}
 
-    if (X.empty() || Y.empty()) {
-        cerr << "Error: No valid numeric data found" << endl;
-        return;
+// Checks k against the row count, printing an error when it does not fit
+bool valid_fold_count(int k, size_t rows) {
+    if (k < 2 || static_cast<size_t>(k) > rows) {
+        cerr << "Error: Cross-validation needs between 2 and " << rows << " folds" << endl;
+        return false;
     }
+    return true;
+}
 
-    // Simple linear regression
-    double sum_x = 0, sum_y = 0, sum_xy = 0, sum_xx = 0;
-    size_t n = X.size();
+void cross_validate(int k, const string& partition, int seed) {
+    TrainingSpec spec;
+    vector<size_t> rows;
+    if (!current_model_spec(partition, spec, rows) || !valid_fold_count(k, rows.size())) return;
+
+    const bool logistic = current_model.logistic();
+    const char* loss = logistic ? "Log-loss" : "MSE";
+    const char* score = logistic ? "Accuracy" : "R-squared";
+    cout << "Cross-validating " << current_model.method << " model of " << current_model.target << " over " << k
+         << " folds of " << rows.size() << " rows (" << partition << ")" << endl;
+
+    auto start = chrono::steady_clock::now();
+    vector<FoldResult> folds = cross_validate_specs(vector<TrainingSpec>(1, spec), rows, k, seed)[0];
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Fold\tTrain\tTest\t" << loss << "\t" << score << "\tSeconds" << endl;
+    for (size_t f = 0; f < folds.size(); ++f) {
+        const FoldResult& fold = folds[f];
+        cout << f + 1 << "\t" << fold.train_rows << "\t" << fold.metrics.rows << "\t";
+        if (fold.ok) {
+            cout << fold.metrics.loss(current_model) << "\t"
+                 << (logistic ? fold.metrics.accuracy : fold.metrics.r_squared);
+        } else {
+            cout << "failed: " << fold.error;
+        }
+        cout << "\t" << fold.seconds << endl;
+    }
 
-    for (size_t i = 0; i < n; i++) {
-        sum_x += X[i];
-        sum_y += Y[i];
-        sum_xy += X[i] * Y[i];
-        sum_xx += X[i] * X[i];
+    FoldSummary summary = summarize_folds(folds, logistic);
+    if (summary.loss.count) {
+        cout << "Mean " << loss << ": " << summary.loss.mean << " (sd " << summary.loss.std_dev() << ")" << endl;
+        cout << "Mean " << score << ": " << summary.score.mean << " (sd " << summary.score.std_dev() << ")" << endl;
     }
+    if (summary.failed) cerr << "Error: " << summary.failed << " folds failed to train" << endl;
+    cout << "Trained " << k << " folds in " << wall << "s (" << summary.seconds << "s of fold time on "
+         << worker_count() << " threads)" << endl;
+}
 
-    model_slope = (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
-    model_intercept = (sum_y - model_slope * sum_x) / n;
+void grid_search(const string& alphas, const string& learning_rates, int k, const string& partition) {
+    TrainingSpec base;
+    vector<size_t> rows;
+    if (!current_model_spec(partition, base, rows) || !valid_fold_count(k, rows.size())) return;
+
+    // Every combination of the listed values; learning rates only apply to SGD
+    vector<double> alpha_values, rate_values;
+    for (const string& item : split_list(alphas)) {
+        double value;
+        if (!parse_double(item, value) || value < 0) {
+            cerr << "Error: Invalid alpha " << item << endl;
+            return;
+        }
+        alpha_values.push_back(value);
+    }
+    for (const string& item : split_list(learning_rates)) {
+        double value;
+        if (!parse_double(item, value) || !(value > 0)) {
+            cerr << "Error: Invalid learning rate " << item << endl;
+            return;
+        }
+        rate_values.push_back(value);
+    }
+    if (alpha_values.empty()) alpha_values.push_back(base.alpha);
+    if (rate_values.empty() || base.method == "normal") rate_values.assign(1, base.sgd.learning_rate);
+
+    vector<TrainingSpec> specs;
+    for (double alpha : alpha_values) {
+        for (double rate : rate_values) {
+            TrainingSpec spec = base;
+            spec.alpha = alpha;
+            spec.sgd.learning_rate = rate;
+            specs.push_back(spec);
+        }
+    }
 
-    cout << "Model trained successfully" << endl;
-    cout << "Equation: y = " << model_slope << "x + " << model_intercept << endl;
+    const bool logistic = current_model.logistic(), sgd = base.method != "normal";
+    const char* loss = logistic ? "Log-loss" : "MSE";
+    cout << "Grid search over " << specs.size() << " settings of the " << base.method << " model of "
+         << current_model.target << ", " << k << "-fold on " << rows.size() << " rows (" << partition << ")" << endl;
+
+    auto start = chrono::steady_clock::now();
+    vector<vector<FoldResult>> results = cross_validate_specs(specs, rows, k, sgd_settings.seed);
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Alpha\t" << (sgd ? "Rate\t" : "") << loss << "\tsd\t" << (logistic ? "Accuracy" : "R-squared")
+         << "\tSeconds" << endl;
+    size_t best = specs.size();
+    vector<FoldSummary> summaries;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        summaries.push_back(summarize_folds(results[i], logistic));
+        const FoldSummary& summary = summaries.back();
+        cout << specs[i].alpha << "\t";
+        if (sgd) cout << specs[i].sgd.learning_rate << "\t";
+        if (summary.failed) {
+            cout << "failed: " << summary.error;
+        } else {
+            cout << summary.loss.mean << "\t" << summary.loss.std_dev() << "\t" << summary.score.mean;
+            if (best == specs.size() || summary.loss.mean < summaries[best].loss.mean) best = i;
+        }
+        cout << "\t" << summary.seconds << endl;
+    }
+    cout << "Ran " << specs.size() * k << " fits in " << wall << "s on " << worker_count() << " threads" << endl;
+    if (best == specs.size()) {
+        cerr << "Error: No setting trained on every fold" << endl;
+        return;
+    }
+
+    // Refit the winner on all of the rows as the current model
+    Model model;
+    string error;
+    if (!fit_model(specs[best], rows, model, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    current_model = model;
+    if (sgd) sgd_settings.learning_rate = specs[best].sgd.learning_rate;
+    cout << "Best: alpha " << specs[best].alpha;
+    if (sgd) cout << ", learning rate " << specs[best].sgd.learning_rate;
+    cout << " (mean " << loss << " " << summaries[best].loss.mean << ")" << endl;
+    print_model(model);
 }
 
-void load_csv(const string& filename) {
+size_t read_csv_rows(istream& file, size_t columns, vector<CSVRow>& rows, bool complete_only) {
+    size_t bytes = 0;
+    string line;
+    while (getline(file, line)) {
+        // getline stops at the end of the file when the line has no newline
+        bool complete = !file.eof();
+        if (complete_only && !complete) break;
+        bytes += line.size() + complete;
+
+        CSVRow row;
+        stringstream ss(line);
+        string cell;
+        while (getline(ss, cell, ',')) {
+            row.data.push_back(cell);
+        }
+
+        // Skip empty rows and rows with column count mismatch
+        if (row.data.size() == columns) {
+            rows.push_back(row);
+        } else if (!line.empty()) {
+            cerr << "Warning: Skipping malformed row: " << line << endl;
+        }
+    }
+    return bytes;
+}
+
+// Reads a CSV file into rows (header first), skipping malformed rows
+bool read_csv(const string& filename, vector<CSVRow>& rows, size_t* bytes) {
     ifstream file(filename);
     string line;
 
     if (!file.is_open()) {
         cerr << "Error: Could not open file " << filename << endl;
-        return;
+        return false;
     }
 
-    dataset.clear();
+    rows.clear();
 
     // Read header
     if (getline(file, line)) {
@@ -267,49 +649,81 @@ void load_csv(const string& filename) {
         while (getline(ss, cell, ',')) {
             header.data.push_back(cell);
         }
-        dataset.push_back(header);
+        rows.push_back(header);
     }
+    if (bytes) *bytes = line.size() + !file.eof();
+    if (rows.empty()) return true;
 
     // Read remaining rows
-    size_t num_cols = dataset[0].data.size(); // Expected columns based on header
-    while (getline(file, line)) {
-        CSVRow row;
-        stringstream ss(line);
-        string cell;
-        while (getline(ss, cell, ',')) {
-            row.data.push_back(cell);
-        }
+    size_t num_cols = rows[0].data.size(); // Expected columns based on header
+    size_t body = read_csv_rows(file, num_cols, rows, false);
+    if (bytes) *bytes += body;
 
-        // Skip empty rows and rows with column count mismatch
-        if (row.data.size() == num_cols) {
-            dataset.push_back(row);
-        } else if (!line.empty()) {
-            cerr << "Warning: Skipping malformed row: " << line << endl;
+    file.close();
+    return true;
+}
+
+void load_csv(const string& filename) {
+    vector<CSVRow> rows;
+    size_t bytes = 0;
+    if (!read_csv(filename, rows, &bytes)) return;
+
+    dataset.swap(rows);
+    discard_view();
+    clear_partitions();
+    invalidate_columns();
+    watch_file(filename, dataset.empty() ? vector<string>() : dataset[0].data, bytes);
+    cout << "Loaded " << (dataset.empty() ? 0 : dataset.size() - 1) << " rows from " << filename << endl;
+}
+
+void follow(double interval_seconds, int ticks) {
+    string error;
+    if (!start_following(interval_seconds, ticks, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    cout << "Following " << (dataset.empty() ? 0 : dataset.size() - 1) << " rows; checking for new rows every "
+         << interval_seconds << " s";
+    if (ticks > 0) cout << ", " << ticks << " times";
+    cout << endl;
+}
+
+void save_csv(const string& filename) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open file " << filename << endl;
+        return;
+    }
+
+    if (dataset.empty()) {
+        cout << "Saved 0 rows to " << filename << endl;
+        return;
+    }
+
+    // Writes the view directly, so a filtered table is never materialised
+    vector<size_t> cols = view_columns();
+    vector<size_t> rows = view_rows();
+    for (size_t r = 0; r <= rows.size(); ++r) {
+        const CSVRow& row = dataset[r == 0 ? 0 : rows[r - 1] + 1];
+        for (size_t i = 0; i < cols.size(); ++i) {
+            if (i > 0) file << ',';
+            file << row.data[cols[i]];
         }
+        file << '\n';
     }
 
-    cout << "Loaded " << dataset.size() - 1 << " rows from " << filename << endl;
-    file.close();
+    cout << "Saved " << rows.size() << " rows to " << filename << endl;
 }
 
 void mean(const string& column) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); i++)
-        if (dataset[0].data[i] == column) index = i;
+    int index = find_column(column);
     if (index == -1) {
         cerr << "Error: Column " << column << " not found." << endl;
         return;
     }
 
-    double sum = 0;
-    int count = 0;
-    for (size_t i = 1; i < dataset.size(); i++) {
-        try {
-            sum += stod(dataset[i].data[index]);
-            count++;
-        } catch (...) {}
-    }
-    cout << "Mean of " << column << ": " << (count ? sum / count : 0) << endl;
+    const RunningStats& stats = column_stats(index);
+    cout << "Mean of " << column << ": " << stats.mean << endl;
 }
 
 void median(const string& column) {
@@ -321,25 +735,17 @@ void median(const string& column) {
         return;
     }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {}
-    }
-
-    if (values.empty()) {
+    QuantileSketch sketch = column_sketch(index, quantile_epsilon);
+    if (sketch.count() == 0) {
         cerr << "Error: No numeric data found in column " << column << "." << endl;
         return;
     }
 
-    sort(values.begin(), values.end());
-    size_t n = values.size();
-    double med = (n % 2 == 0) ? (values[n / 2 - 1] + values[n / 2]) / 2 : values[n / 2];
-    cout << "Median of " << column << ": " << med << endl;
+    double med = sketch.quantile(0.5);
+    cout << "Median of " << column << ": " << med << (sketch.exact() ? "" : " (approximate)") << endl;
 }
 
-void variance(const string& column) {
+void quantile(const string& column, double p) {
     int index = -1;
     for (size_t i = 0; i < dataset[0].data.size(); ++i)
         if (dataset[0].data[i] == column) index = i;
@@ -347,26 +753,22 @@ void variance(const string& column) {
         cerr << "Error: Column " << column << " not found." << endl;
         return;
     }
-
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {}
+    if (p < 0 || p > 1) {
+        cerr << "Error: Quantile must be between 0 and 1." << endl;
+        return;
     }
 
-    if (values.empty()) {
+    QuantileSketch sketch = column_sketch(index, quantile_epsilon);
+    if (sketch.count() == 0) {
         cerr << "Error: No numeric data found in column " << column << "." << endl;
         return;
     }
 
-    double mean_val = accumulate(values.begin(), values.end(), 0.0) / values.size();
-    double sum_sq = 0;
-    for (double val : values) sum_sq += pow(val - mean_val, 2);
-    cout << "Variance of " << column << ": " << (sum_sq / values.size()) << endl;
+    cout << "Quantile " << p << " of " << column << ": " << sketch.quantile(p)
+         << (sketch.exact() ? "" : " (approximate)") << endl;
 }
 
-void standard_deviation(const string& column) {
+void percentiles(const string& column, const vector<double>& percents) {
     int index = -1;
     for (size_t i = 0; i < dataset[0].data.size(); ++i)
         if (dataset[0].data[i] == column) index = i;
@@ -375,61 +777,160 @@ void standard_deviation(const string& column) {
         return;
     }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); i++) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {}
+    vector<double> probs;
+    for (double pct : percents) {
+        if (pct < 0 || pct > 100) {
+            cerr << "Error: Percentiles must be between 0 and 100." << endl;
+            return;
+        }
+        probs.push_back(pct / 100.0);
+    }
+    if (probs.empty()) {
+        probs = {0.25, 0.5, 0.75};
     }
 
-    if (values.empty()) {
+    QuantileSketch sketch = column_sketch(index, quantile_epsilon);
+    if (sketch.count() == 0) {
         cerr << "Error: No numeric data found in column " << column << "." << endl;
         return;
     }
 
-    double mean_val = accumulate(values.begin(), values.end(), 0.0) / values.size();
-    double sum_sq = 0;
-    for (double val : values) sum_sq += (val - mean_val) * (val - mean_val);
-    cout << "Standard Deviation of " << column << ": " << sqrt(sum_sq / values.size()) << endl;
+    // One sketch answers every requested percentile
+    vector<double> values = sketch.quantiles(probs);
+    cout << "Percentiles of " << column << (sketch.exact() ? "" : " (approximate)") << ":" << endl;
+    for (size_t i = 0; i < probs.size(); ++i) {
+        cout << "  " << probs[i] * 100 << "%: " << values[i] << endl;
+    }
 }
 
-void correlation(const string& col1, const string& col2) {
-    int i1 = -1, i2 = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == col1) i1 = i;
-        if (dataset[0].data[i] == col2) i2 = i;
+void quantile_accuracy(double epsilon) {
+    if (epsilon < 0 || epsilon >= 1) {
+        cerr << "Error: Quantile error bound must be in [0, 1)." << endl;
+        return;
     }
+    quantile_epsilon = epsilon;
+    if (epsilon == 0) {
+        cout << "Quantiles will be computed exactly" << endl;
+    } else {
+        cout << "Quantile sketches set to rank error " << epsilon << endl;
+    }
+}
+
+void variance(const string& column) {
+    int index = find_column(column);
+    if (index == -1) {
+        cerr << "Error: Column " << column << " not found." << endl;
+        return;
+    }
+
+    const RunningStats& stats = column_stats(index);
+    if (stats.count == 0) {
+        cerr << "Error: No numeric data found in column " << column << "." << endl;
+        return;
+    }
+    cout << "Variance of " << column << ": " << stats.variance() << endl;
+}
+
+void standard_deviation(const string& column) {
+    int index = find_column(column);
+    if (index == -1) {
+        cerr << "Error: Column " << column << " not found." << endl;
+        return;
+    }
+
+    const RunningStats& stats = column_stats(index);
+    if (stats.count == 0) {
+        cerr << "Error: No numeric data found in column " << column << "." << endl;
+        return;
+    }
+    cout << "Standard Deviation of " << column << ": " << stats.std_dev() << endl;
+}
+
+void correlation(const string& col1, const string& col2) {
+    int i1 = find_column(col1);
+    int i2 = find_column(col2);
 
     if (i1 == -1 || i2 == -1) {
         cerr << "Error: One or both columns not found." << endl;
         return;
     }
 
-    vector<double> x, y;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            x.push_back(stod(dataset[i].data[i1]));
-            y.push_back(stod(dataset[i].data[i2]));
-        } catch (...) {}
-    }
+    // Rows where either value is missing are skipped pairwise
+    const vector<double>& x = numeric_column(i1).values;
+    const vector<double>& y = numeric_column(i2).values;
+    CoMoments moments = kernel_co_moments(x.data(), y.data(), x.size());
 
-    if (x.size() != y.size() || x.empty()) {
+    if (moments.count == 0) {
         cerr << "Error: Insufficient data for correlation calculation." << endl;
         return;
     }
 
-    double mean_x = accumulate(x.begin(), x.end(), 0.0) / x.size();
-    double mean_y = accumulate(y.begin(), y.end(), 0.0) / y.size();
+    double corr = moments.sxy / sqrt(moments.sxx * moments.syy);
+    cout << "Correlation between " << col1 << " and " << col2 << ": " << corr << endl;
+}
+
+// Prints a square matrix over the named columns, or writes it as CSV for plotting
+void report_matrix(const string& title, const vector<string>& names, const vector<double>& values,
+                   const string& output_file) {
+    size_t p = names.size();
+    if (!output_file.empty()) {
+        ofstream out(output_file);
+        if (!out.is_open()) {
+            cerr << "Error: Could not open file " << output_file << " for writing" << endl;
+            return;
+        }
+        out << setprecision(10);
+        for (size_t j = 0; j < p; ++j) out << "," << names[j];
+        out << "\n";
+        for (size_t i = 0; i < p; ++i) {
+            out << names[i];
+            for (size_t j = 0; j < p; ++j) out << "," << values[i * p + j];
+            out << "\n";
+        }
+        cout << title << " (" << p << " x " << p << ") written to " << output_file << endl;
+        return;
+    }
 
-    double num = 0, den_x = 0, den_y = 0;
-    for (size_t i = 0; i < x.size(); ++i) {
-        num += (x[i] - mean_x) * (y[i] - mean_y);
-        den_x += pow(x[i] - mean_x, 2);
-        den_y += pow(y[i] - mean_y, 2);
+    cout << title << ":" << endl;
+    for (size_t j = 0; j < p; ++j) cout << "\t" << names[j];
+    cout << "\n";
+    for (size_t i = 0; i < p; ++i) {
+        cout << names[i];
+        for (size_t j = 0; j < p; ++j) cout << "\t" << values[i * p + j];
+        cout << "\n";
     }
+}
 
-    double corr = num / sqrt(den_x * den_y);
-    cout << "Correlation between " << col1 << " and " << col2 << ": " << corr << endl;
+// Numeric columns of the dataset, in header order
+vector<size_t> numeric_columns() {
+    vector<size_t> cols;
+    if (dataset.empty()) return cols;
+    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
+        if (is_numeric_column(i)) cols.push_back(i);
+    }
+    return cols;
+}
+
+void correlation_matrix(const string& output_file) {
+    vector<size_t> cols = numeric_columns();
+    if (cols.size() < 2) {
+        cerr << "Error: At least two numeric columns are needed for a correlation matrix." << endl;
+        return;
+    }
+
+    CovarianceMatrix matrix = compute_covariance_matrix(cols);
+    report_matrix("Correlation matrix", matrix.names, matrix.correlation, output_file);
+}
+
+void covariance_matrix(const string& output_file) {
+    vector<size_t> cols = numeric_columns();
+    if (cols.empty()) {
+        cerr << "Error: No numeric columns found for a covariance matrix." << endl;
+        return;
+    }
+
+    CovarianceMatrix matrix = compute_covariance_matrix(cols);
+    report_matrix("Covariance matrix", matrix.names, matrix.covariance, output_file);
 }
 
 void scatter_plot(const string& col1, const string& col2) {
@@ -604,47 +1105,71 @@ void histogram(const string& column) {
     cout << "Histogram generated as histogram.png" << endl;
 }
 
-void split_data(double train_ratio) {
+void split_data(double train_ratio, int seed, const string& stratify) {
     if (train_ratio <= 0 || train_ratio >= 1) {
         cerr << "Error: Train ratio must be between 0 and 1." << endl;
         return;
     }
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
+        return;
+    }
 
-    size_t train_size = static_cast<size_t>((dataset.size() - 1) * train_ratio);
-    cout << "Split data with train ratio: " << train_ratio << endl;
-    cout << "Training set size: " << train_size << " samples" << endl;
-    cout << "Test set size: " << (dataset.size() - 1 - train_size) << " samples" << endl;
+    // One stratum holding every row, or one per distinct value of stratify
+    vector<vector<size_t>> strata(1);
+    if (stratify.empty()) {
+        strata[0].resize(dataset.size() - 1);
+        for (size_t row = 0; row < strata[0].size(); ++row) strata[0][row] = row;
+    } else {
+        int index = find_column(stratify);
+        if (index == -1) {
+            cerr << "Error: Column " << stratify << " not found." << endl;
+            return;
+        }
+        DictionaryColumn column = dictionary_column(index);
+        strata.assign(column.values.size(), vector<size_t>());
+        for (size_t row = 0; row < column.ids.size(); ++row) strata[column.ids[row]].push_back(row);
+    }
+
+    // Shuffle each stratum with a seeded generator so splits are repeatable,
+    // then keep train_ratio of it; the partitions are only row indices
+    mt19937_64 rng(seed);
+    vector<size_t> train, test;
+    for (vector<size_t>& stratum : strata) {
+        for (size_t i = stratum.size(); i > 1; --i) swap(stratum[i - 1], stratum[rng() % i]);
+        size_t train_size = static_cast<size_t>(stratum.size() * train_ratio + 0.5);
+        train.insert(train.end(), stratum.begin(), stratum.begin() + train_size);
+        test.insert(test.end(), stratum.begin() + train_size, stratum.end());
+    }
+    sort(train.begin(), train.end());
+    sort(test.begin(), test.end());
+
+    cout << "Split data with train ratio: " << train_ratio << " (seed " << seed;
+    if (!stratify.empty()) cout << ", stratified by " << stratify;
+    cout << ")" << endl;
+    cout << "Training set size: " << train.size() << " samples" << endl;
+    cout << "Test set size: " << test.size() << " samples" << endl;
+    store_partition("train", move(train));
+    store_partition("test", move(test));
 }
 
 void normalize(const string& column) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i)
-        if (dataset[0].data[i] == column) index = i;
+    int index = find_column(column);
 
     if (index == -1) {
         cerr << "Error: Column " << column << " not found." << endl;
         return;
     }
 
-    // Collect numeric values
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {
-            continue;
-        }
-    }
-
-    if (values.empty()) {
+    const NumericColumn& values = numeric_column(index);
+    if (values.valid == 0) {
         cerr << "Error: No numeric data found in column " << column << endl;
         return;
     }
 
-    // Find min and max
-    double min_val = *min_element(values.begin(), values.end());
-    double max_val = *max_element(values.begin(), values.end());
-    double range = max_val - min_val;
+    // Find min and max in one fused pass
+    MinMaxResult bounds = kernel_min_max(values.values.data(), values.values.size());
+    double range = bounds.max - bounds.min;
 
     if (range == 0) {
         cerr << "Warning: Column has zero range, skipping normalization" << endl;
@@ -652,127 +1177,142 @@ void normalize(const string& column) {
     }
 
     // Normalize values between 0 and 1
-    size_t value_index = 0;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            double original = stod(dataset[i].data[index]);
-            double normalized = (original - min_val) / range;
-            dataset[i].data[index] = to_string(normalized);
-            value_index++;
-        } catch (...) {
-            continue;
-        }
-    }
+    vector<double> normalized(values.values.size());
+    kernel_affine(values.values.data(), normalized.size(), bounds.min, 1.0 / range, 0.0, normalized.data());
+    store_numeric_column(index, normalized);
 
     cout << "Column " << column << " normalized successfully" << endl;
 }
 
-void evaluate_model() {
-    if (model_slope == 0.0 && model_intercept == 0.0) {
-        cerr << "Error: No trained model found. Please train the model first." << endl;
+void evaluate_model(const string& partition) {
+    vector<size_t> features, rows;
+    size_t target;
+    if (!model_columns(current_model, features, target)) return;
+    vector<size_t> cols(features);
+    cols.push_back(target);
+    if (!partition_complete_rows(partition, cols, rows)) return;
+    if (rows.empty()) {
+        cerr << "Error: No valid numeric data found" << endl;
         return;
     }
 
-    // Calculate R-squared and Mean Squared Error
-    double ss_total = 0.0;  // Total sum of squares
-    double ss_residual = 0.0;  // Residual sum of squares
-    double y_mean = 0.0;
-    vector<double> actual_values;
-    vector<double> predicted_values;
+    const vector<double> all = predict_column(current_model, features);
+    vector<double> predicted(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) predicted[i] = all[rows[i]];
+    ModelMetrics metrics = model_metrics(current_model, predicted, numeric_column(target).values.data(), rows);
 
-    // First pass: calculate mean of actual values
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            double actual = stod(dataset[i].data[dataset[0].data.size() - 1]);  // Assuming target is last column
-            actual_values.push_back(actual);
-            y_mean += actual;
-        } catch (...) {
-            continue;
-        }
-    }
-    y_mean /= actual_values.size();
-
-    // Second pass: calculate R-squared and MSE
-    for (size_t i = 0; i < actual_values.size(); ++i) {
-        double predicted = model_slope * i + model_intercept;
-        predicted_values.push_back(predicted);
-        
-        ss_total += pow(actual_values[i] - y_mean, 2);
-        ss_residual += pow(actual_values[i] - predicted, 2);
+    cout << "Model Evaluation Metrics (" << partition << ", " << rows.size() << " rows):" << endl;
+    if (current_model.logistic()) {
+        cout << "Log-loss: " << metrics.log_loss << endl;
+        cout << "Accuracy: " << metrics.accuracy << endl;
+        return;
     }
-
-    double r_squared = 1 - (ss_residual / ss_total);
-    double mse = ss_residual / actual_values.size();
-
-    cout << "Model Evaluation Metrics:" << endl;
-    cout << "R-squared: " << r_squared << endl;
-    cout << "Mean Squared Error: " << mse << endl;
-    cout << "Root Mean Squared Error: " << sqrt(mse) << endl;
+    cout << "R-squared: " << metrics.r_squared << endl;
+    cout << "Mean Squared Error: " << metrics.mse << endl;
+    cout << "Root Mean Squared Error: " << sqrt(metrics.mse) << endl;
 }
 
-void save_model(const string& filename) {
-    ofstream model_file(filename);
-    if (!model_file.is_open()) {
-        cerr << "Error: Could not open file " << filename << " for writing" << endl;
+void save_model(const string& filename, const string& format) {
+    if (!current_model.trained()) {
+        cerr << "Error: No trained model found. Please train the model first." << endl;
+        return;
+    }
+    if (format != "text" && format != "binary") {
+        cerr << "Error: Unknown model format " << format << " (use text or binary)" << endl;
+        return;
+    }
+    string error;
+    if (!write_model(current_model, filename, format == "binary", error)) {
+        cerr << "Error: " << error << endl;
         return;
     }
-
-    // Save model parameters
-    model_file << "model_type: linear_regression" << endl;
-    model_file << "slope: " << model_slope << endl;
-    model_file << "intercept: " << model_intercept << endl;
-
-    model_file.close();
     cout << "Model saved successfully to " << filename << endl;
 }
 
-void predict() {
-    if (model_slope == 0.0 && model_intercept == 0.0) {
-        cerr << "Error: No trained model found. Please train the model first." << endl;
+void load_model(const string& filename) {
+    Model model;
+    string error;
+    if (!read_model(filename, model, error)) {
+        cerr << "Error: " << error << endl;
         return;
     }
+    current_model = model;
+    cout << "Model loaded from " << filename << " (" << model.method << ", " << model.features.size()
+         << " features, target " << model.target << ")" << endl;
+}
 
-    cout << "Making predictions using the trained model:" << endl;
-    cout << "Model equation: y = " << model_slope << "x + " << model_intercept << endl;
-    
-    // Make predictions for the test set
-    cout << "\nPredictions:" << endl;
-    cout << "X\tPredicted Y" << endl;
-    cout << "-------------------" << endl;
-    
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            double x = stod(dataset[i].data[0]);  // Assuming feature is first column
-            double predicted_y = model_slope * x + model_intercept;
-            cout << x << "\t" << predicted_y << endl;
-        } catch (...) {
-            continue;
-        }
+void predict(const string& partition, const string& output) {
+    vector<size_t> features, rows;
+    if (!model_features(current_model, features)) return;
+    if (!partition_complete_rows(partition, features, rows)) return;
+
+    // Every row is scored in one pass; rows outside the partition are blanked
+    vector<double> predicted = predict_column(current_model, features);
+    if (partition != "all") {
+        vector<double> scored(predicted.size(), numeric_limits<double>::quiet_NaN());
+        for (size_t row : rows) scored[row] = predicted[row];
+        predicted.swap(scored);
     }
+
+    string name = output.empty() ? "predicted_" + current_model.target : output;
+    write_numeric_column(name, predicted);
+    cout << "Predicted " << current_model.target << " for " << rows.size() << " rows into column " << name << endl;
 }
 
-void group_by_data(const string& column_name) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column_name) {
-            index = i;
-            break;
-        }
+// Prints the header of table and its given data rows (0-based) tab-separated
+void print_rows(const vector<CSVRow>& table, const vector<size_t>& rows) {
+    for (size_t j = 0; j < table[0].data.size(); ++j) cout << (j ? "\t" : "") << table[0].data[j];
+    cout << "\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const vector<string>& cells = table[rows[i] + 1].data;
+        for (size_t j = 0; j < cells.size(); ++j) cout << (j ? "\t" : "") << cells[j];
+        cout << "\n";
     }
+}
 
-    if (index == -1) {
-        cerr << "Error: Column not found: " << column_name << endl;
+void group_by_data(const string& columns, const string& aggregates, const string& output_table) {
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
         return;
     }
 
-    map<string, int> group_counts;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        group_counts[dataset[i].data[index]]++;
+    vector<size_t> keys;
+    vector<AggregateSpec> specs;
+    string error;
+    if (!find_columns(columns, keys, error) || !parse_aggregates(aggregates, specs, error)) {
+        cerr << "Error: " << error << endl;
+        return;
     }
 
-    cout << "Group by " << column_name << ":\n";
-    for (const auto& group : group_counts) {
-        cout << group.first << ": " << group.second << endl;
+    vector<CSVRow> result = hash_aggregate(keys, specs);
+    size_t groups = result.size() - 1;
+
+    cout << "Group by " << columns << ":\n";
+    vector<size_t> shown(min<size_t>(groups, max_display_values));
+    for (size_t i = 0; i < shown.size(); ++i) shown[i] = i;
+    print_rows(result, shown);
+    if (groups > shown.size()) cout << "... (" << groups - shown.size() << " more groups)\n";
+
+    store_table(output_table, move(result));
+    cout << groups << " groups stored as table " << output_table << endl;
+}
+
+void use_table(const string& name) {
+    string error;
+    if (!switch_table(name, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    cout << "Using table " << name << " (" << (dataset.empty() ? 0 : dataset.size() - 1) << " rows)" << endl;
+}
+
+void list_tables() {
+    vector<string> names = table_names();
+    cout << "Tables:\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        const vector<CSVRow>* table = find_table(names[i]);
+        size_t rows = table->empty() ? 0 : table->size() - 1;
+        cout << (names[i] == active_table() ? "* " : "  ") << names[i] << ": " << rows << " rows" << endl;
     }
 }
 
@@ -790,47 +1330,137 @@ void merge_data(const vector<CSVRow>& other_dataset) {
     for (size_t i = 1; i < other_dataset.size(); ++i) {
         dataset.push_back(other_dataset[i]);
     }
+    invalidate_columns();
 
     cout << "Merged datasets successfully." << endl;
 }
 
-void scale_data(const string& column, double new_min, double new_max) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column) {
-            index = i;
-            break;
-        }
+void join(const string& other, const string& left_key, const string& right_key, const string& type) {
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
+        return;
+    }
+
+    JoinType join_type;
+    if (!parse_join_type(type, join_type)) {
+        cerr << "Error: Unknown join type: " << type << " (use inner, left, semi or anti)" << endl;
+        return;
+    }
+    int left_index = find_column(left_key);
+    if (left_index == -1) {
+        cerr << "Error: Column not found: " << left_key << endl;
+        return;
+    }
+
+    // The other side is a named table, or else a CSV file
+    vector<CSVRow> loaded;
+    const vector<CSVRow>* right = find_table(other);
+    if (!right) {
+        if (!read_csv(other, loaded)) return;
+        right = &loaded;
     }
+    if (right->empty()) {
+        cerr << "Error: " << other << " is empty." << endl;
+        return;
+    }
+
+    const string& right_name = right_key.empty() ? left_key : right_key;
+    const vector<string>& right_header = (*right)[0].data;
+    size_t right_index = find(right_header.begin(), right_header.end(), right_name) - right_header.begin();
+    if (right_index == right_header.size()) {
+        cerr << "Error: Column not found in " << other << ": " << right_name << endl;
+        return;
+    }
+
+    JoinStats stats;
+    vector<CSVRow> result = hash_join(*right, left_index, right_index, join_type, stats);
+    dataset.swap(result);
+    clear_partitions();
+    invalidate_columns();
+
+    cout << "Joined " << other << " (" << type << " join on " << left_key;
+    if (right_name != left_key) cout << " = " << right_name;
+    cout << "): " << stats.output_rows << " rows" << endl;
+}
+
+void scale_data(const string& column, double new_min, double new_max) {
+    int index = find_column(column);
 
     if (index == -1) {
         cerr << "Error: Column not found: " << column << endl;
         return;
     }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {}
+    const NumericColumn& values = numeric_column(index);
+    if (values.valid == 0) {
+        cerr << "Error: No numeric data found in column " << column << "." << endl;
+        return;
     }
 
-    if (values.empty()) {
-        cerr << "Error: No numeric data found in column " << column << "." << endl;
+    MinMaxResult bounds = kernel_min_max(values.values.data(), values.values.size());
+    if (bounds.max == bounds.min) {
+        cerr << "Warning: Column has zero range, skipping scaling" << endl;
         return;
     }
 
-    double old_min = *min_element(values.begin(), values.end());
-    double old_max = *max_element(values.begin(), values.end());
+    double factor = (new_max - new_min) / (bounds.max - bounds.min);
+    vector<double> scaled(values.values.size());
+    kernel_affine(values.values.data(), scaled.size(), bounds.min, factor, new_min, scaled.data());
+    store_numeric_column(index, scaled);
 
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            double val = stod(dataset[i].data[index]);
-            dataset[i].data[index] = to_string(((val - old_min) / (old_max - old_min)) * (new_max - new_min) + new_min);
-        } catch (...) {}
+    cout << "Scaled column: " << column << " to range [" << new_min << ", " << new_max << "]" << endl;
+}
+
+void kmeans(const string& columns, int k, const string& output, int batch_size, int max_iterations, int seed) {
+    vector<size_t> cols, rows;
+    string error;
+    if (!find_columns(columns, cols, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    if (cols.empty() || k < 1 || batch_size < 0 || max_iterations < 1) {
+        cerr << "Error: k-means needs columns, k >= 1, a non-negative batch size and at least one iteration" << endl;
+        return;
+    }
+    if (!partition_complete_rows("all", cols, rows)) return;
+    if (rows.size() < static_cast<size_t>(k)) {
+        cerr << "Error: Only " << rows.size() << " complete rows for " << k << " clusters" << endl;
+        return;
     }
 
-    cout << "Scaled column: " << column << " to range [" << new_min << ", " << new_max << "]" << endl;
+    // Contiguous feature-major matrix of the complete rows
+    const size_t n = rows.size(), d = cols.size();
+    vector<double> x(n * d);
+    for (size_t j = 0; j < d; ++j) {
+        const vector<double>& values = numeric_column(cols[j]).values;
+        for (size_t i = 0; i < n; ++i) x[j * n + i] = values[rows[i]];
+    }
+
+    KMeansOptions options;
+    options.k = k;
+    options.batch_size = batch_size;
+    options.max_iterations = max_iterations;
+    options.seed = seed;
+    KMeansResult result = kmeans(x, n, d, options);
+
+    string name = output.empty() ? "cluster" : output;
+    vector<double> ids(dataset.size() - 1, numeric_limits<double>::quiet_NaN());
+    for (size_t i = 0; i < n; ++i) ids[rows[i]] = result.labels[i];
+    write_numeric_column(name, ids);
+
+    cout << "k-means with k = " << k << " on " << n << " rows of " << columns;
+    if (batch_size > 0) cout << " (mini-batches of " << batch_size << ", " << result.iterations << " iterations)";
+    else cout << " (" << result.iterations << " iterations, " << (result.converged ? "converged" : "not converged") << ")";
+    cout << ": added column " << name << endl;
+    cout << "Inertia: " << result.inertia << endl;
+    cout << "Cluster\tSize";
+    for (size_t col : cols) cout << "\t" << dataset[0].data[col];
+    cout << endl;
+    for (int c = 0; c < k; ++c) {
+        cout << c << "\t" << result.sizes[c];
+        for (size_t j = 0; j < d; ++j) cout << "\t" << result.centroids[c * d + j];
+        cout << endl;
+    }
 }
 
 void get_shape() {
@@ -839,7 +1469,7 @@ void get_shape() {
         return;
     }
 
-    cout << "Dataset shape: " << dataset.size() - 1 << " rows x " << dataset[0].data.size() << " columns" << endl;
+    cout << "Dataset shape: " << view_row_count() << " rows x " << view_columns().size() << " columns" << endl;
 }
 
 void data_quality_report() {
@@ -862,7 +1492,7 @@ void data_quality_report() {
     }
 }
 
-void get_column_profile(const string& column) {
+void get_column_profile(const string& column, bool exact) {
     int index = -1;
     for (size_t i = 0; i < dataset[0].data.size(); ++i) {
         if (dataset[0].data[i] == column) {
@@ -876,19 +1506,29 @@ void get_column_profile(const string& column) {
         return;
     }
 
+    DistinctProfile profile = profile_distinct(index, exact, max_display_values);
+
     cout << "Column Profile for: " << column << "\n";
-    set<string> unique_values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        unique_values.insert(dataset[i].data[index]);
+    cout << "Rows: " << profile.rows << " | Nulls: " << profile.nulls << "\n";
+    if (profile.exact) {
+        cout << "Unique Values: " << static_cast<size_t>(profile.distinct) << "\n";
+    } else {
+        cout << "Unique Values: ~" << static_cast<size_t>(profile.distinct + 0.5) << " (approximate)\n";
     }
 
-    cout << "Unique Values: " << unique_values.size() << "\n";
-    for (const auto& value : unique_values) {
-        cout << value << "\n";
+    cout << "Most frequent values:\n";
+    for (const auto& value : profile.frequent) {
+        cout << value.value << ": " << value.count;
+        if (value.error > 0) cout << " (+/- " << value.error << ")";
+        cout << "\n";
+    }
+    if (profile.distinct > profile.frequent.size()) {
+        cout << "... " << static_cast<size_t>(profile.distinct + 0.5) - profile.frequent.size()
+             << " more not shown\n";
     }
 }
 
-void categorize_column(const string& column) {
+void categorize_column(const string& column, bool exact) {
     int index = -1;
     for (size_t i = 0; i < dataset[0].data.size(); ++i) {
         if (dataset[0].data[i] == column) {
@@ -902,123 +1542,124 @@ void categorize_column(const string& column) {
         return;
     }
 
-    set<string> categories;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        categories.insert(dataset[i].data[index]);
-    }
+    DistinctProfile profile = profile_distinct(index, exact, max_display_values);
 
     cout << "Categories in column " << column << ":\n";
-    for (const auto& category : categories) {
-        cout << "- " << category << "\n";
+    for (const auto& category : profile.frequent) {
+        cout << "- " << category.value << "\n";
+    }
+    if (profile.distinct > profile.frequent.size()) {
+        cout << "... and " << (profile.exact ? "" : "~")
+             << static_cast<size_t>(profile.distinct + 0.5) - profile.frequent.size() << " more\n";
     }
 }
 
-void pivot_table(const string& index, const string& columns, const string& values) {
-    int indexCol = -1, colCol = -1, valCol = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == index) indexCol = i;
-        if (dataset[0].data[i] == columns) colCol = i;
-        if (dataset[0].data[i] == values) valCol = i;
+void display_limit(int max_values) {
+    if (max_values <= 0) {
+        cerr << "Error: Display limit must be positive." << endl;
+        return;
     }
+    max_display_values = max_values;
+    cout << "Profiling output limited to " << max_values << " values" << endl;
+}
 
+void pivot_table(const string& index, const string& columns, const string& values, const string& aggregate,
+                 const string& output_table) {
+    int indexCol = find_column(index), colCol = find_column(columns), valCol = find_column(values);
     if (indexCol == -1 || colCol == -1 || valCol == -1) {
         cerr << "Error: One or more columns not found in dataset." << endl;
         return;
     }
 
-    map<string, map<string, double>> pivot;
-    set<string> allColumns;
-
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        string rowIndex = dataset[i].data[indexCol];
-        string colIndex = dataset[i].data[colCol];
-        allColumns.insert(colIndex);
-
-        try {
-            double val = stod(dataset[i].data[valCol]);
-            pivot[rowIndex][colIndex] += val;
-        } catch (...) {
-            continue;
-        }
+    AggregateKind kind;
+    if (!find_aggregate(aggregate, kind) || kind == AGG_VARIANCE || kind == AGG_DISTINCT) {
+        cerr << "Error: Unsupported pivot aggregate: " << aggregate << " (use sum, mean, count, min or max)" << endl;
+        return;
+    }
+    if (kind != AGG_COUNT && !is_numeric_column(valCol)) {
+        cerr << "Error: Column " << values << " is not numeric." << endl;
+        return;
     }
 
-    cout << index;
-    for (const auto& colVal : allColumns)
-        cout << "\t" << colVal;
-    cout << endl;
+    vector<CSVRow> result = dense_pivot(indexCol, colCol, valCol, kind);
+    size_t pivot_rows = result.size() - 1, pivot_columns = result[0].data.size() - 1;
 
-    for (const auto& rowPair : pivot) {
-        cout << rowPair.first;
-        for (const auto& colVal : allColumns) {
-            if (rowPair.second.find(colVal) != rowPair.second.end()) {
-                cout << "\t" << rowPair.second.at(colVal);
-            } else {
-                cout << "\t0";
-            }
-        }
-        cout << endl;
-    }
+    cout << "Pivot Table (" << aggregate << " of " << values << "):\n";
+    vector<size_t> shown(min<size_t>(pivot_rows, max_display_values));
+    for (size_t i = 0; i < shown.size(); ++i) shown[i] = i;
+    print_rows(result, shown);
+    if (pivot_rows > shown.size()) cout << "... (" << pivot_rows - shown.size() << " more rows)\n";
+
+    store_table(output_table, move(result));
+    cout << pivot_rows << " x " << pivot_columns << " pivot stored as table " << output_table << endl;
 }
 
 void drop_column(const string& column_name) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column_name) {
-            index = i;
-            break;
-        }
-    }
-
+    int index = find_column(column_name);
     if (index == -1) {
         cerr << "Error: Column not found: " << column_name << endl;
         return;
     }
 
-    for (auto& row : dataset) {
-        row.data.erase(row.data.begin() + index);
-    }
+    drop_view_column(index);
 
     cout << "Dropped column: " << column_name << endl;
 }
 
 void filter_rows(const string& column_name, const string& value) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column_name) {
-            index = i;
-            break;
-        }
-    }
-
+    int index = find_column(column_name);
     if (index == -1) {
         cerr << "Error: Column not found: " << column_name << endl;
         return;
     }
 
-    vector<CSVRow> filtered_data;
-    filtered_data.push_back(dataset[0]); // Keep header
+    FilterNode equals;
+    equals.column = index;
+    equals.texts.push_back(value);
+    select_view_rows(evaluate_filter(equals, view_rows()));
+    cout << "Filtered rows where " << column_name << " = " << value << endl;
+}
 
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        if (dataset[i].data[index] == value) {
-            filtered_data.push_back(dataset[i]);
-        }
+void filter(const string& expression) {
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
+        return;
     }
 
-    dataset = filtered_data;
-    cout << "Filtered rows where " << column_name << " = " << value << endl;
+    FilterNode root;
+    string error;
+    if (!parse_filter(expression, root, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+
+    // Only the view is narrowed; rows move once, when something needs them
+    size_t before = view_row_count();
+    select_view_rows(evaluate_filter(root, view_rows()));
+    cout << "Filtered rows where " << expression << ": kept " << view_row_count() << " of " << before << endl;
 }
 
-void sort_data(const string& column_name, bool ascending) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column_name) {
-            index = i;
-            break;
-        }
+void create_index(const string& column, const string& type) {
+    IndexKind kind;
+    if (type == "hash") kind = INDEX_HASH;
+    else if (type == "sorted") kind = INDEX_SORTED;
+    else {
+        cerr << "Error: Unknown index type: " << type << " (use hash or sorted)" << endl;
+        return;
     }
 
-    if (index == -1) {
-        cerr << "Error: Column not found: " << column_name << endl;
+    string error;
+    if (!create_column_index(column, kind, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    if (kind == INDEX_HASH) cout << "Created hash index on " << column << " (" << index_size(column) << " distinct values)" << endl;
+    else cout << "Created sorted index on " << column << " (" << index_size(column) << " values)" << endl;
+}
+
+void sort_data(const string& column_name, bool ascending) {
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
         return;
     }
 
@@ -1030,60 +1671,106 @@ void sort_data(const string& column_name, bool ascending) {
         }
     }
 
-    // Sort the data
-    sort(dataset.begin() + 1, dataset.end(), [index, ascending](const CSVRow& a, const CSVRow& b) {
-        try {
-            double val_a = stod(a.data[index]);
-            double val_b = stod(b.data[index]);
-            return ascending ? val_a < val_b : val_a > val_b;
-        } catch (...) {
-            return ascending ? a.data[index] < b.data[index] : a.data[index] > b.data[index];
-        }
-    });
+    vector<SortKey> keys;
+    string error;
+    if (!parse_sort_keys(dataset[0].data, column_name, ascending, keys, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+
+    // Sort a row permutation over precomputed keys, then move each row once
+    reorder_rows(sort_permutation(keys));
 
-    cout << "Sorted data by column: " << column_name << (ascending ? " (ascending)" : " (descending)") << endl;
+    if (keys.size() == 1 && dataset[0].data[keys[0].column] == column_name) {
+        cout << "Sorted data by column: " << column_name << (ascending ? " (ascending)" : " (descending)") << endl;
+        return;
+    }
+    cout << "Sorted data by: ";
+    for (size_t k = 0; k < keys.size(); ++k) {
+        cout << (k ? ", " : "") << dataset[0].data[keys[k].column]
+             << (keys[k].ascending ? " (ascending" : " (descending")
+             << (keys[k].nulls_first ? ", nulls first)" : ")");
+    }
+    cout << endl;
 }
 
-void standardize(const string& column) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column) {
-            index = i;
-            break;
-        }
+void top_k(const string& column, int k, bool ascending) {
+    int index = find_column(column);
+    if (index == -1) {
+        cerr << "Error: Column not found: " << column << endl;
+        return;
     }
+    if (k <= 0) {
+        cerr << "Error: k must be positive." << endl;
+        return;
+    }
+
+    SortKey key = {static_cast<size_t>(index), ascending, false};
+    vector<size_t> rows = top_k_rows(key, k);
+    cout << "Top " << rows.size() << " rows by " << column << (ascending ? " (ascending)" : " (descending)") << ":" << endl;
+    print_rows(dataset, rows);
+}
 
+void nth_value(const string& column, int n, bool ascending) {
+    int index = find_column(column);
     if (index == -1) {
         cerr << "Error: Column not found: " << column << endl;
         return;
     }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {}
+    SortKey key = {static_cast<size_t>(index), ascending, false};
+    size_t row;
+    if (n <= 0 || !nth_row(key, n - 1, row)) {
+        cerr << "Error: " << column << " has no value at position " << n << "." << endl;
+        return;
     }
+    cout << "Value #" << n << " of " << column << (ascending ? " (ascending)" : " (descending)") << ": "
+         << dataset[row + 1].data[index] << endl;
+}
 
-    if (values.empty()) {
-        cerr << "Error: No numeric data found in column " << column << "." << endl;
+void sort_csv(const string& input_file, const string& output_file, const string& column_name, bool ascending) {
+    ExternalSortStats stats;
+    string error;
+    if (!external_sort(input_file, output_file, column_name, ascending, sort_memory_limit, stats, error)) {
+        cerr << "Error: " << error << endl;
         return;
     }
 
-    double mean_val = accumulate(values.begin(), values.end(), 0.0) / values.size();
-    double sum_sq = 0;
-    for (double val : values) {
-        sum_sq += (val - mean_val) * (val - mean_val);
+    cout << "Sorted " << stats.rows << " rows from " << input_file << " into " << output_file
+         << " (" << stats.runs << " runs, " << stats.merge_passes + 1 << " merge passes)" << endl;
+}
+
+void sort_memory(int megabytes) {
+    if (megabytes <= 0) {
+        cerr << "Error: Sort memory must be positive." << endl;
+        return;
     }
-    double std_dev = sqrt(sum_sq / values.size());
+    sort_memory_limit = static_cast<size_t>(megabytes) << 20;
+    cout << "External sort memory set to " << megabytes << " MB" << endl;
+}
 
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            double val = stod(dataset[i].data[index]);
-            dataset[i].data[index] = to_string((val - mean_val) / std_dev);
-        } catch (...) {}
+void standardize(const string& column) {
+    int index = find_column(column);
+
+    if (index == -1) {
+        cerr << "Error: Column not found: " << column << endl;
+        return;
+    }
+
+    const NumericColumn& values = numeric_column(index);
+    if (values.valid == 0) {
+        cerr << "Error: No numeric data found in column " << column << "." << endl;
+        return;
     }
 
+    SumResult total = kernel_sum(values.values.data(), values.values.size());
+    double mean_val = total.sum / total.count;
+    double std_dev = sqrt(kernel_sum_sq_dev(values.values.data(), values.values.size(), mean_val) / total.count);
+
+    vector<double> standardized(values.values.size());
+    kernel_affine(values.values.data(), standardized.size(), mean_val, 1.0 / std_dev, 0.0, standardized.data());
+    store_numeric_column(index, standardized);
+
     cout << "Standardized column: " << column << endl;
 }
 
@@ -1128,6 +1815,7 @@ void remove_stopwords(const string& column) {
         dataset[i].data[index] = result;
     }
     
+    invalidate_column(index);
     cout << "Removed stopwords from column: " << column << endl;
 }
 
@@ -1174,6 +1862,7 @@ void stem_text(const string& column) {
         dataset[i].data[index] = result;
     }
 
+    invalidate_column(index);
     cout << "Applied stemming to column: " << column << endl;
 }
 
@@ -1207,6 +1896,7 @@ void capitalize_words(const string& column) {
         }
     }
 
+    invalidate_column(index);
     cout << "Capitalized words in column: " << column << endl;
 }
 
@@ -1236,55 +1926,161 @@ void count_words(const string& column) {
     }
 }
 
-// Time Series Functions
-void rolling_mean(const string& column, int window_size) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column) {
-            index = i;
-            break;
-        }
-    }
+// A derived column kept up to date across follow ticks: the input rows it
+// covers, the settings it was computed with and the output column's version
+// when it was last written
+struct DerivedColumn {
+    RowWatermark input;
+    string settings;
+    uint64_t output_version = 0;
+};
+
+// First data row of output that needs computing: the rows appended since the
+// last call when settings, inputs and the output column are unchanged, else 0
+size_t derived_start(const DerivedColumn& derived, const string& output, const string& settings,
+                     const vector<size_t>& inputs) {
+    int col = find_column(output);
+    if (col == -1 || settings != derived.settings || column_version(col) != derived.output_version) return 0;
+    return derived.input.covered(inputs);
+}
+
+// Writes the output rows from first on and records what they cover
+void derived_written(DerivedColumn& derived, const string& output, const string& settings,
+                     const vector<size_t>& inputs, const vector<double>& values, size_t first) {
+    size_t col = write_numeric_column(output, vector<double>(values.begin() + first, values.end()), first);
+    derived.settings = settings;
+    derived.output_version = column_version(col);
+    derived.input.advance(inputs);
+}
 
+// Time Series Functions
+void window(const string& column, const string& function, int size, const string& partition, const string& output) {
+    int index = find_column(column);
     if (index == -1) {
         cerr << "Error: Column not found: " << column << endl;
         return;
     }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {
-            cerr << "Error: Non-numeric value found in row " << i << endl;
+    WindowKind kind;
+    if (!find_window_function(function, kind)) {
+        cerr << "Error: Unknown window function: " << function
+             << " (use sum, mean, variance, min, max, ewma, lag, diff or cumsum)" << endl;
+        return;
+    }
+    // Offsets default to one row; every other sized function needs a size
+    if (size <= 0 && (kind == WINDOW_LAG || kind == WINDOW_DIFF)) size = 1;
+    if (size <= 0 && kind != WINDOW_CUMSUM) {
+        cerr << "Error: Window function " << function << " needs a positive size" << endl;
+        return;
+    }
+
+    DictionaryColumn groups;
+    if (!partition.empty()) {
+        int key = find_column(partition);
+        if (key == -1) {
+            cerr << "Error: Column not found: " << partition << endl;
             return;
         }
+        groups = dictionary_column(key);
+    }
+
+    string name = output;
+    if (name.empty()) name = column + "_" + function + (kind == WINDOW_CUMSUM ? "" : "_" + to_string(size));
+
+    // In a follow session ungrouped windows are kept and only extended over
+    // appended rows
+    struct MaintainedWindow : MaintainedState {
+        DerivedColumn derived;
+        vector<double> result;
+    };
+    const vector<double>& values = numeric_column(index).values;
+    if (partition.empty()) {
+        const vector<size_t> inputs(1, static_cast<size_t>(index));
+        const string settings = to_string(kind) + "/" + to_string(size);
+        MaintainedWindow fresh;
+        MaintainedWindow* state = maintained_state<MaintainedWindow>("window/" + name);
+        if (!state) state = &fresh;
+        size_t first = derived_start(state->derived, name, settings, inputs);
+        state->result.resize(first);
+        extend_window_function(values, kind, static_cast<size_t>(max(size, 0)), state->result);
+        derived_written(state->derived, name, settings, inputs, state->result, first);
+    } else {
+        drop_maintained_state("window/" + name);
+        vector<double> result = window_function(values, &groups.ids, groups.values.size(), kind,
+                                                static_cast<size_t>(max(size, 0)));
+        write_numeric_column(name, result);
     }
 
-    if (window_size > static_cast<int>(values.size())) {
-        cerr << "Error: Window size larger than data size" << endl;
+    cout << "Added column " << name << ": " << function << " of " << column;
+    if (kind != WINDOW_CUMSUM) cout << " (" << (kind == WINDOW_EWMA ? "span " : kind == WINDOW_LAG || kind == WINDOW_DIFF ? "offset " : "window ") << size << ")";
+    if (!partition.empty()) cout << " per " << partition;
+    cout << endl;
+}
+
+void rolling_mean(const string& column, int window_size) {
+    window(column, "mean", window_size);
+}
+
+void resample_data(const string& frequency, const string& aggregates, const string& time_column, const string& output_table) {
+    if (dataset.empty()) {
+        cout << "Dataset is empty." << endl;
         return;
     }
 
-    vector<double> rolling_means;
-    for (size_t i = 0; i <= values.size() - window_size; ++i) {
-        double sum = 0;
-        for (int j = 0; j < window_size; ++j) {
-            sum += values[i + j];
-        }
-        rolling_means.push_back(sum / window_size);
+    Frequency step;
+    vector<AggregateSpec> specs;
+    string error;
+    if (!parse_frequency(frequency, step, error) || !parse_aggregates(aggregates, specs, error)) {
+        cerr << "Error: " << error << endl;
+        return;
+    }
+    int time_col = time_column.empty() ? detect_time_column() : find_column(time_column);
+    if (time_col == -1) {
+        cerr << "Error: " << (time_column.empty() ? "No timestamp column found" : "Column not found: " + time_column) << endl;
+        return;
     }
 
-    cout << "Rolling mean (window size " << window_size << ") for " << column << ":" << endl;
-    for (size_t i = 0; i < rolling_means.size(); ++i) {
-        cout << "Position " << (i + window_size) << ": " << rolling_means[i] << endl;
+    // Bucket numbers relative to the first bucket; rows without a time are left out
+    vector<int64_t> buckets = timestamp_column(time_col);
+    int64_t first = numeric_limits<int64_t>::max(), last = numeric_limits<int64_t>::min();
+    size_t skipped = 0;
+    for (int64_t& t : buckets) {
+        if (t == MISSING_TIME) {
+            skipped++;
+            t = -1;
+            continue;
+        }
+        t = bucket_number(t, step);
+        first = min(first, t);
+        last = max(last, t);
+    }
+    if (skipped == buckets.size()) {
+        cerr << "Error: No timestamps found in column " << dataset[0].data[time_col] << endl;
+        return;
+    }
+    const int64_t MAX_BUCKETS = 1 << 22;
+    if (last - first >= MAX_BUCKETS) {
+        cerr << "Error: Resampling to " << frequency << " would create " << last - first + 1
+             << " buckets; use a coarser frequency" << endl;
+        return;
+    }
+    for (int64_t& t : buckets) {
+        if (t != -1) t -= first;
     }
-}
 
-void resample_data(const string& frequency) {
-    cout << "Resampling data to " << frequency << " frequency" << endl;
-    // Implementation would require actual date/time handling
-    cout << "Note: This is a placeholder. Full implementation requires datetime processing" << endl;
+    bool date_only = step.months > 0 || step.seconds % 86400 == 0;
+    vector<string> labels(static_cast<size_t>(last - first + 1));
+    for (size_t b = 0; b < labels.size(); ++b) labels[b] = format_timestamp(bucket_time(first + b, step), date_only);
+
+    bool sorted;
+    vector<CSVRow> result = bucket_aggregate(buckets, dataset[0].data[time_col], labels, specs, sorted);
+    cout << "Resampled " << buckets.size() - skipped << " rows to " << frequency << " buckets ("
+         << (sorted ? "time-sorted, one pass" : "unsorted, parallel") << ")";
+    if (skipped) cout << ", skipped " << skipped << " rows without a timestamp";
+    cout << endl;
+
+    store_table(output_table, move(result));
+    cout << labels.size() << " buckets stored as table " << output_table << endl;
 }
 
 void detect_trends(const string& column) {
@@ -1339,57 +2135,134 @@ void detect_trends(const string& column) {
     }
 }
 
-void seasonal_decompose(const string& column) {
-    cout << "Performing seasonal decomposition for column: " << column << endl;
-    cout << "Note: Full implementation requires seasonal decomposition algorithms" << endl;
-}
-
-void detect_anomalies(const string& column) {
-    int index = -1;
-    for (size_t i = 0; i < dataset[0].data.size(); ++i) {
-        if (dataset[0].data[i] == column) {
-            index = i;
-            break;
-        }
-    }
-
+void seasonal_decompose(const string& column, int period) {
+    int index = find_column(column);
     if (index == -1) {
         cerr << "Error: Column not found: " << column << endl;
         return;
     }
+    const NumericColumn& values = numeric_column(index);
+    const size_t n = values.values.size();
+    if (values.valid < 4) {
+        cerr << "Error: Insufficient data for seasonal decomposition" << endl;
+        return;
+    }
 
-    vector<double> values;
-    for (size_t i = 1; i < dataset.size(); ++i) {
-        try {
-            values.push_back(stod(dataset[i].data[index]));
-        } catch (...) {
-            cerr << "Error: Non-numeric value found in row " << i << endl;
+    size_t length = static_cast<size_t>(max(period, 0));
+    if (length == 0) {
+        vector<double> acf = autocorrelation_fft(values.values, n / 2);
+        length = detect_period(acf);
+        if (length == 0) {
+            cerr << "Error: No seasonal period found in " << column << "; pass one explicitly" << endl;
             return;
         }
+        cout << "Detected period: " << length << " (autocorrelation " << acf[length] << ")" << endl;
+    }
+    if (length < 2 || 2 * length > n) {
+        cerr << "Error: Period must be between 2 and half the series length (" << n / 2 << ")" << endl;
+        return;
     }
 
-    if (values.size() < 2) {
-        cerr << "Error: Insufficient data for anomaly detection" << endl;
+    Decomposition parts = decompose(values.values, length);
+
+    // Strength of seasonality: 1 - Var(residual) / Var(seasonal + residual)
+    RunningStats residual, detrended;
+    for (size_t i = 0; i < n; ++i) {
+        if (parts.residual[i] != parts.residual[i]) continue;
+        residual.add(parts.residual[i]);
+        detrended.add(parts.seasonal[i] + parts.residual[i]);
+    }
+    double strength = detrended.variance() > 0 ? max(0.0, 1 - residual.variance() / detrended.variance()) : 0.0;
+
+    write_numeric_column(column + "_trend", parts.trend);
+    write_numeric_column(column + "_seasonal", parts.seasonal);
+    write_numeric_column(column + "_residual", parts.residual);
+
+    cout << "Seasonal decomposition of " << column << " (period " << length << "): added columns "
+         << column << "_trend, " << column << "_seasonal, " << column << "_residual" << endl;
+    cout << "Seasonal strength: " << strength << endl;
+    if (parts.filled) cout << "Interpolated " << parts.filled << " missing values" << endl;
+}
+
+void autocorrelation(const string& column, int max_lag) {
+    int index = find_column(column);
+    if (index == -1) {
+        cerr << "Error: Column not found: " << column << endl;
+        return;
+    }
+    const NumericColumn& values = numeric_column(index);
+    if (values.valid < 2 || max_lag < 1) {
+        cerr << "Error: Need at least two values and a positive max_lag" << endl;
         return;
     }
 
-    // Calculate mean and standard deviation
-    double sum = accumulate(values.begin(), values.end(), 0.0);
-    double mean = sum / values.size();
+    vector<double> acf = autocorrelation_fft(values.values, max_lag);
+    cout << "Autocorrelation of " << column << ":" << endl;
+    for (size_t lag = 1; lag < acf.size(); ++lag) cout << "Lag " << lag << ": " << acf[lag] << endl;
+
+    size_t period = detect_period(acf);
+    if (period) cout << "Strongest period: " << period << endl;
+}
 
-    double sq_sum = 0;
-    for (double val : values) {
-        sq_sum += (val - mean) * (val - mean);
+void detect_anomalies(const string& column, const string& method, int window, double threshold, const string& output) {
+    int index = find_column(column);
+    if (index == -1) {
+        cerr << "Error: Column not found: " << column << endl;
+        return;
+    }
+    AnomalyMethod kind;
+    if (!find_anomaly_method(method, kind)) {
+        cerr << "Error: Unknown anomaly method: " << method << " (use zscore, ewma or mad)" << endl;
+        return;
+    }
+    if (window < 2 || threshold <= 0) {
+        cerr << "Error: Anomaly detection needs a window of at least 2 and a positive threshold" << endl;
+        return;
     }
-    double std_dev = sqrt(sq_sum / values.size());
 
-    // Detect anomalies using 3-sigma rule
-    cout << "Anomalies detected in " << column << " (using 3-sigma rule):" << endl;
-    for (size_t i = 0; i < values.size(); ++i) {
-        if (abs(values[i] - mean) > 3 * std_dev) {
-            cout << "Row " << (i + 1) << ": " << values[i] << " (anomaly)" << endl;
-        }
+    // In a follow session the detector and its flags are kept, so appended
+    // rows are scored without replaying the series
+    struct MaintainedDetector : MaintainedState {
+        DerivedColumn derived;
+        AnomalyDetector detector;
+        vector<double> flags;
+        size_t flagged = 0;
+    };
+
+    string name = output.empty() ? column + "_anomaly" : output;
+    const vector<size_t> inputs(1, static_cast<size_t>(index));
+    ostringstream settings;
+    settings << method << "/" << window << "/" << threshold;
+    MaintainedDetector fresh;
+    MaintainedDetector* state = maintained_state<MaintainedDetector>("detect_anomalies/" + name);
+    if (!state) state = &fresh;
+    size_t first = derived_start(state->derived, name, settings.str(), inputs);
+    if (first == 0) {
+        state->detector = AnomalyDetector(kind, static_cast<size_t>(window), threshold);
+        state->flags.clear();
+        state->flagged = 0;
+    }
+
+    // Non-numeric cells are skipped and get no flag
+    const vector<double>& values = numeric_column(index).values;
+    state->flags.resize(values.size(), numeric_limits<double>::quiet_NaN());
+    for (size_t row = first; row < values.size(); ++row) {
+        if (values[row] != values[row]) continue;
+        bool anomaly = state->detector.add(values[row]);
+        state->flags[row] = anomaly ? 1.0 : 0.0;
+        state->flagged += anomaly;
+    }
+
+    if (state->detector.seen() <= static_cast<size_t>(window)) {
+        cerr << "Error: Insufficient data for anomaly detection (" << state->detector.seen()
+             << " values, the first " << window << " warm up the detector)" << endl;
+        drop_maintained_state("detect_anomalies/" + name);
+        return;
     }
+
+    derived_written(state->derived, name, settings.str(), inputs, state->flags, first);
+    cout << "Flagged " << state->flagged << " of " << state->detector.seen() << " values in " << column << " ("
+         << method << ", window " << window << ", threshold " << threshold << "): added column " << name << endl;
 }
 
 void describe() {
@@ -1403,55 +2276,39 @@ void describe() {
     cout << "Number of rows: " << dataset.size() - 1 << endl;
     cout << "Number of columns: " << dataset[0].data.size() << endl;
 
-    for (size_t col = 0; col < dataset[0].data.size(); col++) {
-        vector<double> numeric_values;
-        bool is_numeric = true;
-
-        // Try to convert all values to numbers
-        for (size_t row = 1; row < dataset.size(); row++) {
-            try {
-                numeric_values.push_back(stod(dataset[row].data[col]));
-            } catch (...) {
-                is_numeric = false;
-                break;
-            }
-        }
-
-        cout << "\nColumn: " << dataset[0].data[col] << endl;
-        if (is_numeric && !numeric_values.empty()) {
-            // Calculate statistics for numeric columns
-            double sum = accumulate(numeric_values.begin(), numeric_values.end(), 0.0);
-            double mean = sum / numeric_values.size();
-
-            vector<double> sorted_values = numeric_values;
-            sort(sorted_values.begin(), sorted_values.end());
-            double median = sorted_values[sorted_values.size() / 2];
-
-            double sq_sum = 0;
-            for (double val : numeric_values) {
-                sq_sum += (val - mean) * (val - mean);
-            }
-            double std_dev = sqrt(sq_sum / numeric_values.size());
-
+    // All columns are profiled together in one pass over the rows
+    for (const ColumnProfile& profile : profile_columns()) {
+        cout << "\nColumn: " << profile.name << endl;
+        if (profile.numeric) {
             cout << "Type: Numeric" << endl;
-            cout << "Count: " << numeric_values.size() << endl;
-            cout << "Mean: " << mean << endl;
-            cout << "Median: " << median << endl;
-            cout << "Std Dev: " << std_dev << endl;
-            cout << "Min: " << sorted_values.front() << endl;
-            cout << "Max: " << sorted_values.back() << endl;
+            cout << "Count: " << profile.stats.count << endl;
+            cout << "Nulls: " << profile.nulls << endl;
+            cout << "Mean: " << profile.stats.mean << endl;
+            cout << "Median: " << profile.median << endl;
+            cout << "Std Dev: " << profile.stats.std_dev() << endl;
+            cout << "Min: " << profile.stats.min << endl;
+            cout << "25%: " << profile.q1 << endl;
+            cout << "75%: " << profile.q3 << endl;
+            cout << "Max: " << profile.stats.max << endl;
         } else {
             // For non-numeric columns, show unique values and frequencies
-            map<string, int> value_counts;
-            for (size_t row = 1; row < dataset.size(); row++) {
-                value_counts[dataset[row].data[col]]++;
-            }
-
             cout << "Type: Categorical" << endl;
-            cout << "Unique Values: " << value_counts.size() << endl;
+            cout << "Nulls: " << profile.nulls << endl;
+            const size_t distinct = static_cast<size_t>(profile.distinct + 0.5);
+            if (profile.distinct_exact) {
+                cout << "Unique Values: " << distinct << endl;
+            } else {
+                cout << "Unique Values: ~" << distinct << " (approximate)" << endl;
+            }
+            // Most frequent first, already capped at max_display_values
             cout << "Value Counts:" << endl;
-            for (const auto& pair : value_counts) {
-                cout << "  " << pair.first << ": " << pair.second << endl;
+            for (const HeavyHitter& value : profile.frequent) {
+                cout << "  " << value.value << ": " << value.count;
+                if (value.error > 0) cout << " (+/- " << value.error << ")";
+                cout << endl;
+            }
+            if (distinct > profile.frequent.size()) {
+                cout << "  ... " << distinct - profile.frequent.size() << " more not shown" << endl;
             }
         }
     }
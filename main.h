@@ -23,12 +23,21 @@ struct CSVRow {
 
 // Global data storage
 extern vector<CSVRow> dataset;
-extern double model_slope;
-extern double model_intercept;
+extern double quantile_epsilon;   // rank error of quantile sketches, 0 for exact
+extern int max_display_values;    // cap on values listed by profiling functions
+extern size_t sort_memory_limit;  // bytes of rows sort_csv keeps in memory per run
 
 // Function declarations
 bool is_numeric(const string& str);
+bool is_null_value(const string& str);
+bool parse_double(const string& str, double& value);
+bool read_csv(const string& filename, vector<CSVRow>& rows, size_t* bytes = nullptr);
+// Appends the data rows among file's remaining lines to rows, skipping
+// malformed ones, and returns the bytes read. With complete_only a last line
+// without a newline is left unread, as a writer may still be appending it.
+size_t read_csv_rows(istream& file, size_t columns, vector<CSVRow>& rows, bool complete_only);
 void load_csv(const string& filename);
+void follow(double interval_seconds = 60, int ticks = 0);
 void print(const string& message);
 void scatter_plot(const string& col1, const string& col2);
 void remove_nulls();
@@ -40,23 +49,33 @@ void load_excel(const string& filename);
 void fill_nulls(const string& value);
 void rename_column(const string& old_name, const string& new_name);
 void add_column(const string& column_name, const vector<string>& values);
-void group_by_data(const string& column);
+void group_by_data(const string& columns, const string& aggregates = "count", const string& output_table = "grouped");
+void use_table(const string& name);
+void list_tables();
 void merge_data(const vector<CSVRow>& other_dataset);
-void pivot_table(const string& index, const string& columns, const string& values);
+void join(const string& other, const string& left_key, const string& right_key = "", const string& type = "inner");
+void pivot_table(const string& index, const string& columns, const string& values,
+                 const string& aggregate = "sum", const string& output_table = "pivot");
 void mean(const string& column);
 void correlation(const string& col1, const string& col2);
+void correlation_matrix(const string& output_file = "");
+void covariance_matrix(const string& output_file = "");
 void standard_deviation(const string& column);
 void median(const string& column);
 void variance(const string& column);
+void quantile(const string& column, double p);
+void percentiles(const string& column, const vector<double>& percents);
+void quantile_accuracy(double epsilon);
 void plot(const string& col1, const string& col2);
 void bar_chart(const string& column);
 void pie_chart(const string& column);
 void histogram(const string& column);
 void train_model();
-void predict();
-void save_model(const string& filename);
-void evaluate_model();
-void split_data(double train_ratio);
+void predict(const string& partition = "all", const string& output = "");
+void save_model(const string& filename, const string& format = "text");
+void load_model(const string& filename);
+void evaluate_model(const string& partition = "all");
+void split_data(double train_ratio, int seed = 42, const string& stratify = "");
 void normalize(const string& column);
 void standardize(const string& column);
 void scale_data(const string& column, double new_min, double new_max);
@@ -67,18 +86,38 @@ void stem_text(const string& text_column);
 void capitalize_words(const string& text_column);
 void count_words(const string& text_column);
 void rolling_mean(const string& column, int window_size);
-void resample_data(const string& frequency);
+void window(const string& column, const string& function, int size = 0, const string& partition = "", const string& output = "");
+void resample_data(const string& frequency, const string& aggregates = "count", const string& time_column = "",
+                   const string& output_table = "resampled");
 void detect_trends(const string& column);
-void seasonal_decompose(const string& column);
-void detect_anomalies(const string& column);
+void seasonal_decompose(const string& column, int period = 0);
+void autocorrelation(const string& column, int max_lag = 40);
+void detect_anomalies(const string& column, const string& method = "zscore", int window = 100, double threshold = 3.0,
+                      const string& output = "");
+void kmeans(const string& columns, int k, const string& output = "", int batch_size = 0, int max_iterations = 100,
+            int seed = 42);
 void get_shape();
 void data_quality_report();
-void get_column_profile(const string& column);
-void categorize_column(const string& column);
+void get_column_profile(const string& column, bool exact = false);
+void categorize_column(const string& column, bool exact = false);
+void display_limit(int max_values);
 void drop_column(const string& column_name);
 void filter_rows(const string& column_name, const string& value);
+void filter(const string& expression);
+void create_index(const string& column, const string& type = "hash");
 void sort_data(const string& column_name, bool ascending = true);
-void train_model(const string& feature, const string& target);
+void sort_csv(const string& input_file, const string& output_file, const string& column_name, bool ascending = true);
+void sort_memory(int megabytes);
+void top_k(const string& column, int k, bool ascending = false);
+void nth_value(const string& column, int n, bool ascending = true);
+void train_model(const string& features, const string& target, const string& partition = "all", double alpha = 0.0,
+                 const string& method = "normal");
+void train_model_csv(const string& filename, const string& features, const string& target,
+                     const string& method = "sgd", double alpha = 0.0);
+void cross_validate(int k = 5, const string& partition = "all", int seed = 42);
+void grid_search(const string& alphas, const string& learning_rates = "", int k = 5, const string& partition = "all");
+void sgd_options(double learning_rate, int epochs = 100, int batch_size = 1024, int patience = 5,
+                 double validation = 0.1);
 void describe();
 void execute_generated_code();
 void process_custom_code(const string& custom_code_file);
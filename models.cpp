@@ -0,0 +1,372 @@
+#include "models.h"
+#include "columns.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "stats_engine.h"
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+Model current_model;
+
+namespace {
+
+// Rows per parallel chunk of the normal-equation pass, and rows packed per block
+const size_t MODEL_GRAIN = 16384;
+const size_t MODEL_ROW_BLOCK = 256;
+
+// Relative pivot below which the scaled system counts as singular
+const double SINGULAR_PIVOT = 1e-10;
+
+// Rows per parallel chunk of predict_column, and rows scored per block so
+// the block of outputs stays in L1 while every feature is added to it
+const size_t PREDICT_GRAIN = 1 << 16;
+const size_t PREDICT_BLOCK = 2048;
+
+// Binary model file: this header, then features doubles of weights, then
+// the target and feature names, each NUL-terminated
+const char MODEL_MAGIC[8] = {'C', 'S', 'V', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t MODEL_VERSION = 1;
+
+struct ModelFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t method;       // index into MODEL_METHODS
+    uint64_t features;
+    uint64_t rows;
+    double intercept;
+    double alpha;
+    uint64_t name_bytes;
+    uint64_t reserved;
+};
+
+const char* const MODEL_METHODS[] = {"normal", "sgd", "logistic"};
+const uint32_t MODEL_METHOD_COUNT = 3;
+
+// Parses the text format from its key: value lines
+bool parse_model_text(const string& text, Model& model, string& error) {
+    istringstream in(text);
+    string line;
+    Model parsed;
+    bool has_weights = false;
+    while (getline(in, line)) {
+        size_t colon = line.find(": ");
+        if (colon == string::npos) continue;
+        const string key = line.substr(0, colon), value = line.substr(colon + 2);
+        if (key == "method") {
+            parsed.method = value;
+        } else if (key == "model_type") {
+            if (value == "logistic_regression") parsed.method = "logistic";
+        } else if (key == "features") {
+            parsed.features = split_list(value);
+        } else if (key == "target") {
+            parsed.target = value;
+        } else if (key == "weights") {
+            parsed.weights.clear();
+            for (const string& item : split_list(value)) parsed.weights.push_back(strtod(item.c_str(), nullptr));
+            has_weights = true;
+        } else if (key == "intercept") {
+            parsed.intercept = strtod(value.c_str(), nullptr);
+        } else if (key == "alpha") {
+            parsed.alpha = strtod(value.c_str(), nullptr);
+        } else if (key == "rows") {
+            parsed.rows = strtoull(value.c_str(), nullptr, 10);
+        }
+    }
+    if (parsed.features.empty() || !has_weights || parsed.weights.size() != parsed.features.size()) {
+        error = "Model file has no features or a weight count that does not match them";
+        return false;
+    }
+    model = parsed;
+    return true;
+}
+
+// Decodes the binary format from the file bytes
+bool parse_model_binary(const char* data, size_t size, Model& model, string& error) {
+    ModelFileHeader header;
+    memcpy(&header, data, sizeof(header));
+    const size_t weight_bytes = header.features * sizeof(double);
+    if (header.version != MODEL_VERSION || header.method >= MODEL_METHOD_COUNT ||
+        header.features > (size - sizeof(header)) / sizeof(double) ||
+        header.name_bytes != size - sizeof(header) - weight_bytes || header.name_bytes == 0 ||
+        data[size - 1] != '\0') {
+        error = "Binary model file is corrupt or from another version";
+        return false;
+    }
+
+    Model parsed;
+    parsed.method = MODEL_METHODS[header.method];
+    parsed.rows = header.rows;
+    parsed.intercept = header.intercept;
+    parsed.alpha = header.alpha;
+    parsed.weights.resize(header.features);
+    memcpy(parsed.weights.data(), data + sizeof(header), weight_bytes);
+
+    const char* name = data + sizeof(header) + weight_bytes;
+    const char* end = data + size;
+    parsed.target = name;
+    name += parsed.target.size() + 1;
+    while (name < end) {
+        parsed.features.push_back(name);
+        name += parsed.features.back().size() + 1;
+    }
+    if (parsed.features.size() != header.features) {
+        error = "Binary model file is corrupt or from another version";
+        return false;
+    }
+    model = parsed;
+    return true;
+}
+
+// In-place Cholesky factorisation A = L L^T of the n x n row-major matrix a
+// (lower triangle used), then solves A x = b into b. False when a pivot is
+// not clearly positive.
+bool cholesky_solve(vector<double>& a, vector<double>& b, size_t n) {
+    for (size_t j = 0; j < n; ++j) {
+        double d = a[j * n + j];
+        for (size_t k = 0; k < j; ++k) d -= a[j * n + k] * a[j * n + k];
+        if (!(d > SINGULAR_PIVOT)) return false;
+        d = sqrt(d);
+        a[j * n + j] = d;
+        for (size_t i = j + 1; i < n; ++i) {
+            double s = a[i * n + j];
+            for (size_t k = 0; k < j; ++k) s -= a[i * n + k] * a[j * n + k];
+            a[i * n + j] = s / d;
+        }
+    }
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < i; ++k) b[i] -= a[i * n + k] * b[k];
+        b[i] /= a[i * n + i];
+    }
+    for (size_t i = n; i-- > 0;) {
+        for (size_t k = i + 1; k < n; ++k) b[i] -= a[k * n + i] * b[k];
+        b[i] /= a[i * n + i];
+    }
+    return true;
+}
+
+} // namespace
+
+vector<size_t> complete_rows(const vector<size_t>& rows, const vector<size_t>& cols) {
+    vector<const double*> data;
+    for (size_t col : cols) data.push_back(numeric_column(col).values.data());
+
+    vector<size_t> result;
+    result.reserve(rows.size());
+    for (size_t row : rows) {
+        bool complete = true;
+        for (size_t c = 0; c < data.size() && complete; ++c) complete = data[c][row] == data[c][row];
+        if (complete) result.push_back(row);
+    }
+    return result;
+}
+
+bool fit_linear(const vector<size_t>& features, size_t target, const vector<size_t>& rows, double alpha,
+                Model& model, string& error) {
+    const size_t p = features.size(), w = p + 1;
+    if (rows.size() < 2) {
+        error = "Not enough complete rows to train on";
+        return false;
+    }
+
+    // Columns 0 .. p - 1 are the features and p the target, each shifted by
+    // its column mean so the product sums do not cancel
+    vector<const double*> data(w);
+    vector<double> shift(w);
+    for (size_t i = 0; i < w; ++i) {
+        const NumericColumn& column = numeric_column(i < p ? features[i] : target);
+        data[i] = column.values.data();
+        SumResult total = kernel_sum(data[i], column.values.size());
+        shift[i] = total.count ? total.sum / total.count : 0.0;
+    }
+
+    // Per chunk: sums of the shifted values and the upper triangle of their
+    // w x w cross products
+    struct Moments {
+        vector<double> sum, cross;
+    };
+    vector<Moments> partials(chunk_count(rows.size(), MODEL_GRAIN));
+    parallel_for(rows.size(), MODEL_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        Moments& acc = partials[chunk];
+        acc.sum.assign(w, 0.0);
+        acc.cross.assign(w * w, 0.0);
+        vector<double> block(MODEL_ROW_BLOCK * w);
+        for (size_t first = begin; first < end; first += MODEL_ROW_BLOCK) {
+            const size_t len = min(MODEL_ROW_BLOCK, end - first);
+
+            // Gather the block row-major, then rank-1 updates over contiguous rows
+            for (size_t i = 0; i < w; ++i) {
+                for (size_t r = 0; r < len; ++r) block[r * w + i] = data[i][rows[first + r]] - shift[i];
+            }
+            for (size_t r = 0; r < len; ++r) {
+                const double* z = &block[r * w];
+                for (size_t i = 0; i < w; ++i) {
+                    acc.sum[i] += z[i];
+                    double* out = &acc.cross[i * w];
+                    const double zi = z[i];
+                    for (size_t j = i; j < w; ++j) out[j] += zi * z[j];
+                }
+            }
+        }
+    });
+
+    vector<double> sum(w, 0.0), cross(w * w, 0.0);
+    for (const Moments& part : partials) {
+        for (size_t i = 0; i < w; ++i) sum[i] += part.sum[i];
+        for (size_t i = 0; i < w * w; ++i) cross[i] += part.cross[i];
+    }
+
+    // Centred cross products C = Z^T Z - n m m^T
+    const double n = static_cast<double>(rows.size());
+    auto centred = [&](size_t i, size_t j) {
+        if (i > j) swap(i, j);
+        return cross[i * w + j] - sum[i] * sum[j] / n;
+    };
+
+    // Solve (C_xx + alpha I) b = C_xy scaled to unit diagonal, which makes
+    // the singularity test independent of the features' units
+    vector<double> scale(p), a(p * p), b(p);
+    for (size_t i = 0; i < p; ++i) {
+        double d = centred(i, i) + alpha;
+        if (!(d > 0)) {
+            error = "Feature " + dataset[0].data[features[i]] + " is constant over the training rows";
+            return false;
+        }
+        scale[i] = 1.0 / sqrt(d);
+    }
+    for (size_t i = 0; i < p; ++i) {
+        for (size_t j = 0; j < p; ++j) a[i * p + j] = (centred(i, j) + (i == j ? alpha : 0.0)) * scale[i] * scale[j];
+        b[i] = centred(i, p) * scale[i];
+    }
+    if (!cholesky_solve(a, b, p)) {
+        error = "Features are collinear; drop one or train with a ridge alpha above 0";
+        return false;
+    }
+
+    model = Model();
+    for (size_t i = 0; i < p; ++i) model.features.push_back(dataset[0].data[features[i]]);
+    model.target = dataset[0].data[target];
+    model.weights.resize(p);
+    model.intercept = shift[p] + sum[p] / n;
+    for (size_t i = 0; i < p; ++i) {
+        model.weights[i] = b[i] * scale[i];
+        model.intercept -= model.weights[i] * (shift[i] + sum[i] / n);
+    }
+    model.alpha = alpha;
+    model.rows = rows.size();
+    return true;
+}
+
+vector<double> predict_column(const Model& model, const vector<size_t>& features) {
+    vector<const double*> data;
+    for (size_t col : features) data.push_back(numeric_column(col).values.data());
+
+    vector<double> result(dataset.size() - 1);
+    parallel_for(result.size(), PREDICT_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t first = begin; first < end; first += PREDICT_BLOCK) {
+            const size_t len = min(PREDICT_BLOCK, end - first);
+            double* out = &result[first];
+            // A missing feature turns the sum into NaN
+            fill(out, out + len, model.intercept);
+            for (size_t i = 0; i < data.size(); ++i) kernel_axpy(model.weights[i], data[i] + first, len, out);
+            if (model.logistic()) {
+                for (size_t r = 0; r < len; ++r) out[r] = 1.0 / (1.0 + exp(-out[r]));
+            }
+        }
+    });
+    return result;
+}
+
+ModelMetrics model_metrics(const Model& model, const vector<double>& predicted, const double* y,
+                           const vector<size_t>& rows) {
+    ModelMetrics metrics;
+    metrics.rows = rows.size();
+    if (rows.empty()) return metrics;
+
+    if (model.logistic()) {
+        size_t correct = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const double actual = y[rows[i]];
+            double p = min(max(predicted[i], 1e-15), 1 - 1e-15);
+            metrics.log_loss -= actual == 1 ? log(p) : log(1 - p);
+            correct += (p >= 0.5) == (actual == 1);
+        }
+        metrics.log_loss /= rows.size();
+        metrics.accuracy = static_cast<double>(correct) / rows.size();
+        return metrics;
+    }
+
+    RunningStats actual;
+    double ss_residual = 0.0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        double error = y[rows[i]] - predicted[i];
+        actual.add(y[rows[i]]);
+        ss_residual += error * error;
+    }
+    metrics.mse = ss_residual / rows.size();
+    metrics.r_squared = 1 - ss_residual / actual.m2;
+    return metrics;
+}
+
+bool write_model(const Model& model, const string& filename, bool binary, string& error) {
+    ofstream file(filename, binary ? ios::binary : ios::out);
+    if (!file.is_open()) {
+        error = "Could not open file " + filename + " for writing";
+        return false;
+    }
+
+    if (binary) {
+        string names = model.target + '\0';
+        for (const string& name : model.features) names += name + '\0';
+        ModelFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MODEL_MAGIC, sizeof(header.magic));
+        header.version = MODEL_VERSION;
+        header.method = find(MODEL_METHODS, MODEL_METHODS + MODEL_METHOD_COUNT, model.method) - MODEL_METHODS;
+        header.features = model.features.size();
+        header.rows = model.rows;
+        header.intercept = model.intercept;
+        header.alpha = model.alpha;
+        header.name_bytes = names.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(model.weights.data()), model.weights.size() * sizeof(double));
+        file.write(names.data(), names.size());
+    } else {
+        // Enough digits to read the parameters back exactly
+        file << setprecision(17);
+        file << "model_type: " << (model.logistic() ? "logistic_regression" : "linear_regression") << endl;
+        file << "method: " << model.method << endl;
+        file << "features: ";
+        for (size_t i = 0; i < model.features.size(); ++i) file << (i ? "," : "") << model.features[i];
+        file << endl;
+        file << "target: " << model.target << endl;
+        file << "weights: ";
+        for (size_t i = 0; i < model.weights.size(); ++i) file << (i ? "," : "") << model.weights[i];
+        file << endl;
+        file << "intercept: " << model.intercept << endl;
+        file << "alpha: " << model.alpha << endl;
+        file << "rows: " << model.rows << endl;
+    }
+
+    file.close();
+    if (!file) {
+        error = "Could not write " + filename;
+        return false;
+    }
+    return true;
+}
+
+bool read_model(const string& filename, Model& model, string& error) {
+    // A model is a few hundred bytes; one buffered read beats mapping it
+    ifstream file(filename, ios::binary);
+    stringstream buffer;
+    if (!file.is_open() || !(buffer << file.rdbuf())) {
+        error = "Could not read model file " + filename;
+        return false;
+    }
+    const string data = buffer.str();
+    return data.size() >= sizeof(ModelFileHeader) && memcmp(data.data(), MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0
+        ? parse_model_binary(data.data(), data.size(), model, error)
+        : parse_model_text(data, model, error);
+}
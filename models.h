@@ -0,0 +1,73 @@
+#ifndef MODELS_H
+#define MODELS_H
+
+#include "main.h"
+
+// A trained model: prediction = intercept + sum of weights[i] * features[i],
+// passed through the logistic function for logistic regression
+struct Model {
+    string method = "normal";  // normal, sgd or logistic
+    vector<string> features;
+    string target;
+    vector<double> weights;   // one per feature
+    double intercept = 0.0;
+    double alpha = 0.0;       // ridge penalty it was trained with
+    size_t rows = 0;          // training rows
+
+    bool trained() const { return !features.empty(); }
+    bool logistic() const { return method == "logistic"; }
+};
+
+// The model train_model fitted last, used by predict, evaluate_model and
+// save_model
+extern Model current_model;
+
+// The rows among rows where every one of cols holds a number
+vector<size_t> complete_rows(const vector<size_t>& rows, const vector<size_t>& cols);
+
+// Least squares (ridge when alpha > 0) of target on features over rows,
+// which must be complete. X^T X and X^T y of the centred columns are
+// accumulated in one cache-blocked parallel pass and the p x p system is
+// solved by Cholesky factorisation after scaling it to unit diagonal. False
+// with error set for a constant feature or collinear features.
+bool fit_linear(const vector<size_t>& features, size_t target, const vector<size_t>& rows, double alpha,
+                Model& model, string& error);
+
+// Predictions of model for every data row, from its feature columns given
+// in model order; NaN where a feature is missing. One vectorised pass over
+// row blocks split across threads. Must be called from the main thread.
+vector<double> predict_column(const Model& model, const vector<size_t>& features);
+
+// How well a model's predictions match the target: mse and r_squared for
+// linear models, log_loss and accuracy (at a 0.5 threshold) for logistic ones
+struct ModelMetrics {
+    size_t rows = 0;
+    double mse = 0.0, r_squared = 0.0;
+    double log_loss = 0.0, accuracy = 0.0;
+
+    // The quantity to minimise when comparing models
+    double loss(const Model& model) const { return model.logistic() ? log_loss : mse; }
+};
+
+// Metrics of predicted[i] against y[rows[i]]
+ModelMetrics model_metrics(const Model& model, const vector<double>& predicted, const double* y,
+                           const vector<size_t>& rows);
+
+// Writes model as text (key: value lines, readable back exactly) or, when
+// binary, as a fixed header followed by the weights and names in native byte
+// order. False with error set when the file cannot be written.
+bool write_model(const Model& model, const string& filename, bool binary, string& error);
+
+// Reads a model written by write_model in either format, telling them apart
+// by the binary magic; binary weights are copied out without text parsing.
+bool read_model(const string& filename, Model& model, string& error);
+
+// Prediction for data row row from the feature columns (in model order);
+// a probability for logistic models
+inline double model_prediction(const Model& model, const vector<const double*>& columns, size_t row) {
+    double y = model.intercept;
+    for (size_t i = 0; i < columns.size(); ++i) y += model.weights[i] * columns[i][row];
+    return model.logistic() ? 1.0 / (1.0 + exp(-y)) : y;
+}
+
+#endif // MODELS_H
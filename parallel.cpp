@@ -0,0 +1,82 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+thread_local bool inside_parallel_region = false;
+}
+
+unsigned worker_count() {
+    static const unsigned workers = [] {
+        unsigned n = std::thread::hardware_concurrency();
+        return n ? n : 1u;
+    }();
+    return workers;
+}
+
+std::size_t chunk_count(std::size_t n, std::size_t grain) {
+    if (n == 0) return 0;
+    if (grain == 0) grain = 1;
+
+    // A few chunks per worker keeps threads busy when chunks cost different amounts
+    std::size_t by_grain = (n + grain - 1) / grain;
+    std::size_t max_chunks = static_cast<std::size_t>(worker_count()) * 4;
+    return std::min(by_grain, max_chunks);
+}
+
+void parallel_for(std::size_t n, std::size_t grain,
+                  const std::function<void(std::size_t, std::size_t, std::size_t)>& body) {
+    std::size_t chunks = chunk_count(n, grain);
+    if (chunks == 0) return;
+
+    std::size_t per_chunk = n / chunks;
+    std::size_t extra = n % chunks;
+    auto run_chunk = [&](std::size_t chunk) {
+        std::size_t begin = chunk * per_chunk + std::min(chunk, extra);
+        std::size_t end = begin + per_chunk + (chunk < extra ? 1 : 0);
+        body(chunk, begin, end);
+    };
+
+    std::size_t threads = std::min<std::size_t>(worker_count(), chunks);
+    if (threads <= 1 || inside_parallel_region) {
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            run_chunk(chunk);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next_chunk(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        inside_parallel_region = true;
+        for (;;) {
+            std::size_t chunk = next_chunk++;
+            if (chunk >= chunks) break;
+            try {
+                run_chunk(chunk);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next_chunk = chunks;
+            }
+        }
+        inside_parallel_region = false;
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,22 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+// Number of worker threads used by parallel_for (hardware concurrency, at least 1)
+unsigned worker_count();
+
+// Number of chunks parallel_for splits n items into for the given grain size.
+// Callers use it to size per-chunk partial results before the parallel pass.
+std::size_t chunk_count(std::size_t n, std::size_t grain);
+
+// Runs body(chunk, begin, end) over [0, n) split into chunk_count(n, grain)
+// contiguous chunks spread across worker threads. Chunk boundaries depend only
+// on n, grain and the worker count, so merging partials in chunk order is
+// deterministic. Nested calls run serially on the calling thread, and the
+// first exception thrown by a chunk is rethrown on the caller.
+void parallel_for(std::size_t n, std::size_t grain,
+                  const std::function<void(std::size_t, std::size_t, std::size_t)>& body);
+
+#endif // PARALLEL_H
@@ -0,0 +1,156 @@
+#include "seasonal.h"
+#include <cmath>
+#include <complex>
+#include <limits>
+
+namespace {
+
+const double NaN = numeric_limits<double>::quiet_NaN();
+
+bool present(double x) {
+    return x == x;
+}
+
+// In-place iterative radix-2 FFT; a.size() must be a power of two. Twiddle
+// factors come from one table of exact roots rather than repeated products,
+// which would drift over millions of points.
+void fft(vector<complex<double>>& a, bool inverse) {
+    const size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) swap(a[i], a[j]);
+    }
+
+    const double pi = acos(-1.0);
+    vector<complex<double>> roots(n / 2);
+    for (size_t k = 0; k < roots.size(); ++k) {
+        double angle = 2 * pi * k / n * (inverse ? 1 : -1);
+        roots[k] = complex<double>(cos(angle), sin(angle));
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        const size_t half = length / 2, stride = n / length;
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t k = 0; k < half; ++k) {
+                complex<double> even = a[start + k];
+                complex<double> odd = a[start + k + half] * roots[k * stride];
+                a[start + k] = even + odd;
+                a[start + k + half] = even - odd;
+            }
+        }
+    }
+}
+
+} // namespace
+
+vector<double> autocorrelation_fft(const vector<double>& values, size_t max_lag) {
+    const size_t n = values.size();
+    max_lag = min(max_lag, n == 0 ? 0 : n - 1);
+    vector<double> acf(max_lag + 1, 0.0);
+    if (n == 0) return acf;
+
+    double sum = 0.0;
+    size_t count = 0;
+    for (double x : values) {
+        if (!present(x)) continue;
+        sum += x;
+        count++;
+    }
+    const double mean = count ? sum / count : 0.0;
+
+    // Padding to 2n keeps the circular correlation from wrapping around
+    size_t size = 1;
+    while (size < 2 * n) size <<= 1;
+    vector<complex<double>> spectrum(size);
+    for (size_t i = 0; i < n; ++i) spectrum[i] = present(values[i]) ? values[i] - mean : 0.0;
+
+    fft(spectrum, false);
+    for (complex<double>& c : spectrum) c = norm(c);
+    fft(spectrum, true);
+
+    const double variance = spectrum[0].real();
+    if (variance <= 0) {
+        acf[0] = 1.0;
+        return acf;
+    }
+    for (size_t lag = 0; lag <= max_lag; ++lag) acf[lag] = spectrum[lag].real() / variance;
+    return acf;
+}
+
+size_t detect_period(const vector<double>& acf, double min_correlation) {
+    double best = min_correlation;
+    bool found = false;
+    for (size_t lag = 2; lag + 1 < acf.size(); ++lag) {
+        if (acf[lag] > acf[lag - 1] && acf[lag] >= acf[lag + 1] && acf[lag] >= best) {
+            best = acf[lag];
+            found = true;
+        }
+    }
+    if (!found) return 0;
+
+    for (size_t lag = 2; lag + 1 < acf.size(); ++lag) {
+        if (acf[lag] > acf[lag - 1] && acf[lag] >= acf[lag + 1] && acf[lag] >= 0.9 * best) return lag;
+    }
+    return 0;
+}
+
+Decomposition decompose(const vector<double>& values, size_t period) {
+    const size_t n = values.size();
+    Decomposition result;
+    result.trend.assign(n, NaN);
+    result.seasonal.assign(n, NaN);
+    result.residual.assign(n, NaN);
+
+    // Linear interpolation inside the series, nearest value at the ends
+    vector<double> x(values);
+    size_t previous = n;
+    for (size_t i = 0; i < n; ++i) {
+        if (!present(x[i])) continue;
+        size_t from = previous == n ? 0 : previous + 1;
+        for (size_t j = from; j < i; ++j) {
+            x[j] = previous == n ? x[i] : x[previous] + (x[i] - x[previous]) * (j - previous) / (i - previous);
+            result.filled++;
+        }
+        previous = i;
+    }
+    if (previous == n) return result;
+    for (size_t j = previous + 1; j < n; ++j) {
+        x[j] = x[previous];
+        result.filled++;
+    }
+
+    // Centred moving average from prefix sums of the shifted series
+    const double shift = x[0];
+    vector<double> prefix(n + 1, 0.0);
+    for (size_t i = 0; i < n; ++i) prefix[i + 1] = prefix[i] + (x[i] - shift);
+    const size_t half = period / 2;
+    for (size_t i = half; i + half < n; ++i) {
+        double window = prefix[i + half + 1] - prefix[i - half];
+        if (period % 2 == 0) window -= 0.5 * ((x[i - half] - shift) + (x[i + half] - shift));
+        result.trend[i] = shift + window / period;
+    }
+
+    vector<double> phase_sum(period, 0.0);
+    vector<size_t> phase_count(period, 0);
+    for (size_t i = 0; i < n; ++i) {
+        if (!present(result.trend[i])) continue;
+        phase_sum[i % period] += x[i] - result.trend[i];
+        phase_count[i % period]++;
+    }
+    double center = 0.0;
+    for (size_t p = 0; p < period; ++p) {
+        phase_sum[p] = phase_count[p] ? phase_sum[p] / phase_count[p] : 0.0;
+        center += phase_sum[p];
+    }
+    center /= period;
+
+    for (size_t i = 0; i < n; ++i) {
+        result.seasonal[i] = phase_sum[i % period] - center;
+        if (present(values[i]) && present(result.trend[i])) {
+            result.residual[i] = values[i] - result.trend[i] - result.seasonal[i];
+        }
+    }
+    return result;
+}
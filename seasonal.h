@@ -0,0 +1,28 @@
+#ifndef SEASONAL_H
+#define SEASONAL_H
+
+#include "main.h"
+
+// Sample autocorrelation of values (NaN entries count as the mean) for lags
+// 0 .. max_lag, from the power spectrum of the zero-padded, centred series:
+// two radix-2 FFTs, O(n log n) for any max_lag
+vector<double> autocorrelation_fft(const vector<double>& values, size_t max_lag);
+
+// Strongest repeating lag of an autocorrelation: the smallest local peak
+// within 90% of the highest one, so multiples of the period are not picked.
+// 0 when no peak reaches min_correlation.
+size_t detect_period(const vector<double>& acf, double min_correlation = 0.1);
+
+// Classical additive decomposition values = trend + seasonal + residual.
+// The trend is the centred moving average over one period (2 x period for
+// even periods) from prefix sums, O(n); the seasonal part is the mean
+// detrended value at each phase, centred on zero. Gaps inside the series are
+// interpolated first; trend and residual are NaN for the half period at
+// each end.
+struct Decomposition {
+    vector<double> trend, seasonal, residual;
+    size_t filled = 0;   // missing values interpolated
+};
+Decomposition decompose(const vector<double>& values, size_t period);
+
+#endif // SEASONAL_H
@@ -0,0 +1,387 @@
+#include "sgd.h"
+#include "columns.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "stats_engine.h"
+#include <cmath>
+#include <limits>
+#include <random>
+
+SgdOptions sgd_settings;
+
+namespace {
+
+// Feature values a gradient chunk must cover to pay for starting its thread
+const size_t MIN_CHUNK_VALUES = 1 << 15;
+
+// Adam moment decay rates and denominator guard
+const double BETA1 = 0.9;
+const double BETA2 = 0.999;
+const double ADAM_EPSILON = 1e-8;
+
+// Relative drop in validation loss that counts as an improvement
+const double MIN_IMPROVEMENT = 1e-6;
+
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Rows go to the validation split by a hash of their number, so the split is
+// the same every epoch and for every way of visiting the rows
+bool held_out(size_t row, const SgdOptions& options) {
+    uint64_t h = splitmix64(row ^ (static_cast<uint64_t>(options.seed) << 32));
+    return (h >> 11) * (1.0 / 9007199254740992.0) < options.validation;
+}
+
+// log(1 + e^z) without overflow
+double softplus(double z) {
+    return z > 0 ? z + log1p(exp(-z)) : log1p(exp(z));
+}
+
+// Examples one at a time, restartable for each epoch
+class ExampleSource {
+public:
+    virtual ~ExampleSource() {}
+    // Starts a pass over the examples; epoch 0 is the statistics pass
+    virtual bool rewind(size_t epoch, string& error) = 0;
+    // Next example's row number, feature values and target; false at the end
+    virtual bool next(size_t& row, double* values, double& target) = 0;
+};
+
+// Complete rows of the loaded table, reshuffled every epoch
+class TableSource : public ExampleSource {
+public:
+    TableSource(const vector<size_t>& features, size_t target, const vector<size_t>& rows, unsigned seed)
+        : order(rows), seed(seed) {
+        for (size_t col : features) columns.push_back(numeric_column(col).values.data());
+        target_values = numeric_column(target).values.data();
+    }
+
+    bool rewind(size_t epoch, string&) override {
+        if (epoch > 0) {
+            mt19937_64 rng(seed + epoch);
+            shuffle(order.begin(), order.end(), rng);
+        }
+        position = 0;
+        return true;
+    }
+
+    bool next(size_t& row, double* values, double& target) override {
+        if (position == order.size()) return false;
+        row = order[position++];
+        for (size_t j = 0; j < columns.size(); ++j) values[j] = columns[j][row];
+        target = target_values[row];
+        return true;
+    }
+
+private:
+    vector<const double*> columns;
+    const double* target_values;
+    vector<size_t> order;
+    unsigned seed;
+    size_t position = 0;
+};
+
+// Data lines of a CSV file in file order, read afresh each epoch
+class CsvSource : public ExampleSource {
+public:
+    CsvSource(const string& filename, const vector<string>& features, const string& target)
+        : filename(filename), names(features) {
+        names.push_back(target);
+    }
+
+    bool rewind(size_t, string& error) override {
+        file.close();
+        file.clear();
+        file.open(filename);
+        if (!file.is_open()) {
+            error = "Could not open file " + filename;
+            return false;
+        }
+
+        string line, cell;
+        getline(file, line);
+        vector<string> header;
+        stringstream ss(line);
+        while (getline(ss, cell, ',')) header.push_back(cell);
+        columns.clear();
+        for (const string& name : names) {
+            auto it = find(header.begin(), header.end(), name);
+            if (it == header.end()) {
+                error = "Column not found in " + filename + ": " + name;
+                return false;
+            }
+            columns.push_back(it - header.begin());
+        }
+        width = header.size();
+        line_number = 0;
+        return true;
+    }
+
+    bool next(size_t& row, double* values, double& target) override {
+        while (getline(file, line)) {
+            row = line_number++;
+            cells.clear();
+            size_t start = 0;
+            for (size_t comma; (comma = line.find(',', start)) != string::npos; start = comma + 1) {
+                cells.push_back(line.substr(start, comma - start));
+            }
+            cells.push_back(line.substr(start));
+            if (cells.size() != width) continue;
+
+            bool complete = true;
+            const size_t p = columns.size() - 1;
+            for (size_t j = 0; j <= p && complete; ++j) {
+                const string& text = cells[columns[j]];
+                complete = !is_null_value(text) && parse_double(text, j < p ? values[j] : target);
+            }
+            if (complete) return true;
+        }
+        return false;
+    }
+
+private:
+    string filename;
+    vector<string> names;   // features, then the target
+    vector<size_t> columns;
+    size_t width = 0;
+    ifstream file;
+    size_t line_number = 0;
+    string line;
+    vector<string> cells;
+};
+
+// Standardised examples, stored feature-major so each feature is contiguous
+struct Batch {
+    size_t features = 0, capacity = 0, size = 0;
+    vector<double> x, y;
+
+    Batch(size_t features, size_t capacity)
+        : features(features), capacity(capacity), x(features * capacity), y(capacity) {}
+
+    const double* feature(size_t j) const { return &x[j * capacity]; }
+    bool full() const { return size == capacity; }
+    void add(const double* values, double target) {
+        for (size_t j = 0; j < features; ++j) x[j * capacity + size] = values[j];
+        y[size++] = target;
+    }
+};
+
+// Rows per chunk of a batch's gradient pass: about four chunks per worker,
+// unless that leaves chunks too small to be worth a thread
+size_t gradient_grain(const Batch& batch) {
+    return max<size_t>(batch.size / (4 * worker_count()), MIN_CHUNK_VALUES / (batch.features + 1) + 1);
+}
+
+// Summed loss of the batch under weights (bias last), and when gradient is
+// given the summed loss gradient. Chunks of the batch are evaluated on
+// separate threads and their partials added in chunk order, so the update is
+// the same as a serial pass.
+double batch_loss(const Batch& batch, const vector<double>& weights, bool logistic, vector<double>* gradient) {
+    const size_t p = batch.features;
+    const size_t grain = gradient_grain(batch);
+    struct Partial {
+        double loss = 0.0;
+        vector<double> gradient;
+    };
+    vector<Partial> partials(chunk_count(batch.size, grain));
+    parallel_for(batch.size, grain, [&](size_t chunk, size_t begin, size_t end) {
+        const size_t len = end - begin;
+        Partial& acc = partials[chunk];
+
+        vector<double> z(len, weights[p]);
+        for (size_t j = 0; j < p; ++j) kernel_axpy(weights[j], batch.feature(j) + begin, len, z.data());
+
+        // z becomes the residual (prediction - target), the loss derivative
+        for (size_t r = 0; r < len; ++r) {
+            const double y = batch.y[begin + r];
+            if (logistic) {
+                acc.loss += softplus(z[r]) - y * z[r];
+                z[r] = 1.0 / (1.0 + exp(-z[r])) - y;
+            } else {
+                z[r] -= y;
+                acc.loss += z[r] * z[r];
+            }
+        }
+
+        if (!gradient) return;
+        acc.gradient.resize(p + 1);
+        for (size_t j = 0; j < p; ++j) acc.gradient[j] = kernel_dot(batch.feature(j) + begin, z.data(), len);
+        acc.gradient[p] = kernel_sum(z.data(), len).sum;
+    });
+
+    double loss = 0.0;
+    if (gradient) gradient->assign(p + 1, 0.0);
+    for (const Partial& part : partials) {
+        loss += part.loss;
+        if (!gradient) continue;
+        for (size_t j = 0; j <= p; ++j) (*gradient)[j] += part.gradient[j];
+    }
+    return loss;
+}
+
+// One Adam step on the mean gradient of a batch
+class AdamOptimizer {
+public:
+    AdamOptimizer(size_t size, double learning_rate) : m(size, 0.0), v(size, 0.0), learning_rate(learning_rate) {}
+
+    void step(vector<double>& weights, const vector<double>& gradient) {
+        steps++;
+        const double correct1 = 1.0 - pow(BETA1, static_cast<double>(steps));
+        const double correct2 = 1.0 - pow(BETA2, static_cast<double>(steps));
+        for (size_t j = 0; j < weights.size(); ++j) {
+            m[j] = BETA1 * m[j] + (1 - BETA1) * gradient[j];
+            v[j] = BETA2 * v[j] + (1 - BETA2) * gradient[j] * gradient[j];
+            weights[j] -= learning_rate * (m[j] / correct1) / (sqrt(v[j] / correct2) + ADAM_EPSILON);
+        }
+    }
+
+private:
+    vector<double> m, v;
+    double learning_rate;
+    size_t steps = 0;
+};
+
+// Trains model on the examples of source, whose values follow the order of
+// features
+bool train(ExampleSource& source, const vector<string>& features, const string& target_name, double alpha,
+           bool logistic, const SgdOptions& options, Model& model, SgdReport& report, string& error) {
+    const size_t p = features.size();
+    report = SgdReport();
+    vector<double> values(p);
+    size_t row;
+    double target;
+
+    // Statistics pass: standardisation of the training rows
+    vector<RunningStats> stats(p);
+    RunningStats target_stats;
+    if (!source.rewind(0, error)) return false;
+    while (source.next(row, values.data(), target)) {
+        if (logistic && target != 0 && target != 1) {
+            error = "Logistic regression needs a target of 0 or 1, found " + to_string(target);
+            return false;
+        }
+        if (held_out(row, options)) {
+            report.holdout_rows++;
+            continue;
+        }
+        for (size_t j = 0; j < p; ++j) stats[j].add(values[j]);
+        target_stats.add(target);
+    }
+    const size_t n = target_stats.count;
+    if (n < 2) {
+        error = "Not enough complete rows to train on";
+        return false;
+    }
+    vector<double> center(p), inverse_scale(p);
+    for (size_t j = 0; j < p; ++j) {
+        if (!(stats[j].std_dev() > 0)) {
+            error = "Feature " + features[j] + " is constant over the training rows";
+            return false;
+        }
+        center[j] = stats[j].mean;
+        inverse_scale[j] = 1.0 / stats[j].std_dev();
+    }
+    // Linear targets are standardised too so one learning rate suits any units
+    const double target_center = logistic ? 0.0 : target_stats.mean;
+    const double target_scale = logistic || !(target_stats.std_dev() > 0) ? 1.0 : target_stats.std_dev();
+
+    vector<double> weights(p + 1, 0.0), best, gradient;
+    if (logistic) {
+        double rate = min(max(target_stats.mean, 1e-6), 1 - 1e-6);
+        weights[p] = log(rate / (1 - rate));
+    }
+    AdamOptimizer adam(p + 1, options.learning_rate);
+    const size_t batch_size = max<size_t>(options.batch_size, 1);
+    Batch train_batch(p, batch_size), holdout_batch(p, batch_size);
+
+    double best_loss = numeric_limits<double>::infinity();
+    size_t stale = 0;
+    for (size_t epoch = 1; epoch <= options.epochs; ++epoch) {
+        // Losses are progressive: each batch is scored before it updates the
+        // weights, and holdout rows with the weights of the moment
+        double train_loss = 0.0, holdout_loss = 0.0;
+        auto flush_train = [&]() {
+            if (train_batch.size == 0) return;
+            train_loss += batch_loss(train_batch, weights, logistic, &gradient);
+            for (size_t j = 0; j <= p; ++j) {
+                gradient[j] /= train_batch.size;
+                if (j < p) gradient[j] += alpha * weights[j] / n;
+            }
+            adam.step(weights, gradient);
+            train_batch.size = 0;
+        };
+        auto flush_holdout = [&]() {
+            if (holdout_batch.size == 0) return;
+            holdout_loss += batch_loss(holdout_batch, weights, logistic, nullptr);
+            holdout_batch.size = 0;
+        };
+
+        if (!source.rewind(epoch, error)) return false;
+        while (source.next(row, values.data(), target)) {
+            for (size_t j = 0; j < p; ++j) values[j] = (values[j] - center[j]) * inverse_scale[j];
+            target = (target - target_center) / target_scale;
+            if (held_out(row, options)) {
+                holdout_batch.add(values.data(), target);
+                if (holdout_batch.full()) flush_holdout();
+            } else {
+                train_batch.add(values.data(), target);
+                if (train_batch.full()) flush_train();
+            }
+        }
+        flush_train();
+        flush_holdout();
+
+        // Mean loss in the target's units
+        const double units = logistic ? 1.0 : target_scale * target_scale;
+        train_loss *= units / n;
+        holdout_loss = report.holdout_rows ? holdout_loss * units / report.holdout_rows : train_loss;
+        report.epochs = epoch;
+        if (holdout_loss < best_loss * (1 - MIN_IMPROVEMENT) || best.empty()) {
+            best_loss = holdout_loss;
+            best = weights;
+            report.best_epoch = epoch;
+            report.train_loss = train_loss;
+            report.validation_loss = holdout_loss;
+            stale = 0;
+        } else if (++stale >= options.patience) {
+            report.stopped_early = true;
+            break;
+        }
+    }
+    if (best.empty()) best = weights;
+
+    // Undo the standardisation
+    model = Model();
+    model.features = features;
+    model.target = target_name;
+    model.method = logistic ? "logistic" : "sgd";
+    model.weights.resize(p);
+    model.intercept = target_center + target_scale * best[p];
+    for (size_t j = 0; j < p; ++j) {
+        model.weights[j] = target_scale * best[j] * inverse_scale[j];
+        model.intercept -= model.weights[j] * center[j];
+    }
+    model.alpha = alpha;
+    model.rows = n;
+    return true;
+}
+
+} // namespace
+
+bool fit_sgd(const vector<size_t>& features, size_t target, const vector<size_t>& rows, double alpha,
+             bool logistic, const SgdOptions& options, Model& model, SgdReport& report, string& error) {
+    vector<string> names;
+    for (size_t col : features) names.push_back(dataset[0].data[col]);
+    TableSource source(features, target, rows, options.seed);
+    return train(source, names, dataset[0].data[target], alpha, logistic, options, model, report, error);
+}
+
+bool fit_sgd_csv(const string& filename, const vector<string>& features, const string& target, double alpha,
+                 bool logistic, const SgdOptions& options, Model& model, SgdReport& report, string& error) {
+    CsvSource source(filename, features, target);
+    return train(source, features, target, alpha, logistic, options, model, report, error);
+}
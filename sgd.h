@@ -0,0 +1,46 @@
+#ifndef SGD_H
+#define SGD_H
+
+#include "main.h"
+#include "models.h"
+
+// Settings of the mini-batch optimiser, changed with sgd_options()
+struct SgdOptions {
+    double learning_rate = 0.01;
+    size_t epochs = 100;
+    size_t batch_size = 1024;
+    size_t patience = 5;       // epochs without a better validation loss before stopping
+    double validation = 0.1;   // fraction of rows held out for early stopping
+    unsigned seed = 42;
+};
+
+extern SgdOptions sgd_settings;
+
+// How a fit went; losses are mean squared error for linear models and mean
+// log-loss for logistic ones, in the target's units
+struct SgdReport {
+    size_t epochs = 0;        // epochs run
+    size_t best_epoch = 0;    // epoch whose weights were kept
+    double train_loss = 0.0;
+    double validation_loss = 0.0;
+    size_t holdout_rows = 0;
+    bool stopped_early = false;
+};
+
+// Linear (logistic = false) or logistic regression of target on features
+// over rows, which must be complete, by mini-batch Adam on standardised
+// features. Each epoch visits the training rows in a fresh shuffled order;
+// rows hashed into the validation split are only scored, and training stops
+// once their loss has not improved for options.patience epochs, keeping the
+// best weights. alpha is an L2 penalty on the standardised weights. Logistic
+// targets must be 0 or 1. False with error set when training cannot start.
+bool fit_sgd(const vector<size_t>& features, size_t target, const vector<size_t>& rows, double alpha,
+             bool logistic, const SgdOptions& options, Model& model, SgdReport& report, string& error);
+
+// The same fit streamed from a CSV file one batch at a time, without loading
+// it: rows are visited in file order each epoch and rows with a missing or
+// non-numeric feature or target are skipped.
+bool fit_sgd_csv(const string& filename, const vector<string>& features, const string& target, double alpha,
+                 bool logistic, const SgdOptions& options, Model& model, SgdReport& report, string& error);
+
+#endif // SGD_H
@@ -0,0 +1,314 @@
+#include "sketches.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace {
+
+std::uint64_t mix64(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+std::uint64_t rotate_left(std::uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+} // namespace
+
+std::uint64_t hash_string(const std::string& value) {
+    const char* data = value.data();
+    std::size_t length = value.size();
+    std::uint64_t hash = 0x9E3779B97F4A7C15ULL ^ (length * 0xC2B2AE3D27D4EB4FULL);
+
+    // Eight bytes at a time, then the tail
+    std::size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash ^= word * 0x87C37B91114253D5ULL;
+        hash = rotate_left(hash, 31) * 0x4CF5AD432745937FULL;
+    }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, data + i, length - i);
+    hash ^= tail * 0x87C37B91114253D5ULL;
+
+    return mix64(hash);
+}
+
+QuantileSketch::QuantileSketch(double epsilon)
+    : k(0), total(0), retained(0), retained_limit(0),
+      rng_state(0x9E3779B97F4A7C15ULL), levels(1) {
+    if (epsilon > 0) {
+        double size = std::ceil(2.0 / epsilon);
+        k = static_cast<std::size_t>(std::min(65536.0, std::max(16.0, size)));
+    }
+    update_limit();
+}
+
+// Level capacities shrink by 2/3 per level below the top, never under 2
+std::size_t QuantileSketch::capacity(std::size_t level) const {
+    std::size_t depth = levels.size() - 1 - level;
+    double cap = std::ceil(k * std::pow(2.0 / 3.0, static_cast<double>(depth)));
+    return std::max<std::size_t>(2, static_cast<std::size_t>(cap));
+}
+
+void QuantileSketch::update_limit() {
+    if (k == 0) {
+        retained_limit = std::numeric_limits<std::size_t>::max();
+        return;
+    }
+    retained_limit = 0;
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        retained_limit += capacity(level);
+    }
+}
+
+bool QuantileSketch::coin_flip() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state & 1;
+}
+
+void QuantileSketch::add(double value) {
+    levels[0].push_back(value);
+    total++;
+    retained++;
+    if (retained >= retained_limit) compress();
+}
+
+// Compacts the lowest over-full level: sort it and promote every other item
+// (random offset) to the next level with doubled weight
+void QuantileSketch::compress() {
+    while (retained >= retained_limit) {
+        for (std::size_t level = 0; level < levels.size(); ++level) {
+            if (levels[level].size() < capacity(level)) continue;
+
+            if (level + 1 == levels.size()) {
+                levels.emplace_back();
+                update_limit();
+            }
+
+            std::vector<double>& items = levels[level];
+            std::sort(items.begin(), items.end());
+
+            // An odd item out stays behind so the total weight is preserved
+            std::size_t start = items.size() % 2;
+            std::size_t offset = coin_flip() ? 1 : 0;
+            std::vector<double>& next = levels[level + 1];
+            for (std::size_t i = start + offset; i < items.size(); i += 2) {
+                next.push_back(items[i]);
+            }
+
+            std::size_t promoted = (items.size() - start) / 2;
+            retained -= items.size() - start - promoted;
+            items.resize(start);
+            break;
+        }
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+    if (other.levels.size() > levels.size()) {
+        levels.resize(other.levels.size());
+        update_limit();
+    }
+    for (std::size_t level = 0; level < other.levels.size(); ++level) {
+        levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+    }
+    total += other.total;
+    retained += other.retained;
+    if (retained >= retained_limit) compress();
+}
+
+double QuantileSketch::quantile(double p) {
+    return quantiles(std::vector<double>(1, p))[0];
+}
+
+std::vector<double> QuantileSketch::quantiles(const std::vector<double>& probs) {
+    std::vector<double> result;
+    if (total == 0) {
+        result.assign(probs.size(), std::nan(""));
+        return result;
+    }
+
+    if (exact()) {
+        std::vector<double>& items = levels[0];
+        std::size_t n = items.size();
+        bool sorted = probs.size() > 1;
+        if (sorted) std::sort(items.begin(), items.end());
+
+        for (double p : probs) {
+            p = std::min(1.0, std::max(0.0, p));
+            double position = p * (n - 1);
+            std::size_t lo = static_cast<std::size_t>(position);
+            std::size_t hi = std::min(n - 1, lo + 1);
+            double frac = position - lo;
+
+            double lo_value, hi_value;
+            if (sorted) {
+                lo_value = items[lo];
+                hi_value = items[hi];
+            } else {
+                // Single query: selection instead of a full sort
+                std::nth_element(items.begin(), items.begin() + lo, items.end());
+                lo_value = items[lo];
+                hi_value = hi == lo ? lo_value : *std::min_element(items.begin() + lo + 1, items.end());
+            }
+            result.push_back(lo_value + (hi_value - lo_value) * frac);
+        }
+        return result;
+    }
+
+    // Weighted nearest rank over all retained items
+    std::vector<std::pair<double, std::size_t>> weighted;
+    weighted.reserve(retained);
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        std::size_t weight = static_cast<std::size_t>(1) << level;
+        for (double value : levels[level]) {
+            weighted.push_back(std::make_pair(value, weight));
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    for (double p : probs) {
+        p = std::min(1.0, std::max(0.0, p));
+        double target = p * (total - 1);
+        std::size_t cumulative = 0;
+        double value = weighted.back().first;
+        for (const auto& item : weighted) {
+            cumulative += item.second;
+            if (cumulative > target) {
+                value = item.first;
+                break;
+            }
+        }
+        result.push_back(value);
+    }
+    return result;
+}
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision(std::min(18, std::max(4, precision))),
+      registers(static_cast<std::size_t>(1) << this->precision, 0) {}
+
+void HyperLogLog::add_hash(std::uint64_t hash) {
+    std::size_t index = hash >> (64 - precision);
+    // Guard bit keeps the rank bounded when the remaining bits are all zero
+    std::uint64_t rest = (hash << precision) | (static_cast<std::uint64_t>(1) << (precision - 1));
+    std::uint8_t rank = static_cast<std::uint8_t>(__builtin_clzll(rest) + 1);
+    if (rank > registers[index]) registers[index] = rank;
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    if (other.precision != precision) return;
+    for (std::size_t i = 0; i < registers.size(); ++i) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers.size());
+    double sum = 0.0;
+    std::size_t zeros = 0;
+    for (std::uint8_t reg : registers) {
+        sum += std::ldexp(1.0, -reg);
+        if (reg == 0) zeros++;
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+
+    // Linear counting is more accurate while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / zeros);
+    }
+    return estimate;
+}
+
+HeavyHitters::HeavyHitters(std::size_t capacity)
+    : capacity(std::max<std::size_t>(1, capacity)), evicted(false) {}
+
+void HeavyHitters::swap_slots(std::size_t a, std::size_t b) {
+    std::swap(heap[a], heap[b]);
+    position[heap[a].value] = a;
+    position[heap[b].value] = b;
+}
+
+void HeavyHitters::sift_down(std::size_t slot) {
+    for (;;) {
+        std::size_t smallest = slot;
+        std::size_t left = 2 * slot + 1, right = left + 1;
+        if (left < heap.size() && heap[left].count < heap[smallest].count) smallest = left;
+        if (right < heap.size() && heap[right].count < heap[smallest].count) smallest = right;
+        if (smallest == slot) return;
+        swap_slots(slot, smallest);
+        slot = smallest;
+    }
+}
+
+void HeavyHitters::add(const std::string& value, std::size_t weight) {
+    auto found = position.find(value);
+    if (found != position.end()) {
+        std::size_t slot = found->second;
+        heap[slot].count += weight;
+        sift_down(slot);
+        return;
+    }
+
+    if (heap.size() < capacity) {
+        HeavyHitter entry = {value, weight, 0};
+        heap.push_back(entry);
+        std::size_t slot = heap.size() - 1;
+        position[value] = slot;
+        // New entries can be smaller than their parents
+        while (slot > 0) {
+            std::size_t parent = (slot - 1) / 2;
+            if (heap[parent].count <= heap[slot].count) break;
+            swap_slots(slot, parent);
+            slot = parent;
+        }
+        return;
+    }
+
+    // Replace the minimum counter; its count becomes the newcomer's error
+    evicted = true;
+    HeavyHitter& root = heap[0];
+    position.erase(root.value);
+    root.error = root.count;
+    root.count += weight;
+    root.value = value;
+    position[value] = 0;
+    sift_down(0);
+}
+
+void HeavyHitters::merge(const HeavyHitters& other) {
+    if (other.evicted) evicted = true;
+    for (const HeavyHitter& entry : other.heap) {
+        std::size_t before = heap.empty() ? 0 : heap[0].count;
+        bool was_full = heap.size() >= capacity && position.find(entry.value) == position.end();
+        add(entry.value, entry.count);
+        if (was_full) {
+            // add() charged the evicted minimum as error; carry the other side's error too
+            heap[position[entry.value]].error = before + entry.error;
+        } else if (entry.error) {
+            heap[position[entry.value]].error += entry.error;
+        }
+    }
+}
+
+std::vector<HeavyHitter> HeavyHitters::top(std::size_t n) const {
+    std::vector<HeavyHitter> result(heap);
+    std::sort(result.begin(), result.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+        return a.count != b.count ? a.count > b.count : a.value < b.value;
+    });
+    if (result.size() > n) result.resize(n);
+    return result;
+}
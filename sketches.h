@@ -0,0 +1,94 @@
+#ifndef SKETCHES_H
+#define SKETCHES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Fast 64-bit hash of a string's bytes, well mixed in every bit so sketches
+// and hash tables can take bucket and register bits from anywhere
+std::uint64_t hash_string(const std::string& value);
+
+// Mergeable streaming quantile sketch (KLL). With epsilon > 0 it holds about
+// 3 / epsilon values and answers within roughly epsilon normalized rank error;
+// epsilon == 0 keeps every value and answers exactly. Until the first
+// compaction (fewer values than the sketch capacity) answers are exact too.
+class QuantileSketch {
+public:
+    explicit QuantileSketch(double epsilon = 0.01);
+
+    void add(double value);
+    void merge(const QuantileSketch& other);
+
+    std::size_t count() const { return total; }
+    bool exact() const { return levels.size() <= 1; }
+
+    // p in [0, 1]; exact answers interpolate between neighbouring ranks
+    double quantile(double p);
+    std::vector<double> quantiles(const std::vector<double>& probs);
+
+private:
+    std::size_t k;                               // 0 means exact mode
+    std::size_t total;                           // values added, including merged ones
+    std::size_t retained;                        // values currently held
+    std::size_t retained_limit;                  // compaction threshold for the current height
+    std::uint64_t rng_state;
+    std::vector<std::vector<double>> levels;     // level h items weigh 2^h
+
+    std::size_t capacity(std::size_t level) const;
+    void update_limit();
+    void compress();
+    bool coin_flip();
+};
+
+// Mergeable distinct-count estimator. 2^precision one-byte registers; the
+// standard error is about 1.04 / sqrt(2^precision), 0.8% at the default 14.
+class HyperLogLog {
+public:
+    explicit HyperLogLog(int precision = 14);
+
+    void add_hash(std::uint64_t hash);
+    void add(const std::string& value) { add_hash(hash_string(value)); }
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+
+private:
+    int precision;
+    std::vector<std::uint8_t> registers;
+};
+
+struct HeavyHitter {
+    std::string value;
+    std::size_t count;   // upper bound on the true frequency
+    std::size_t error;   // count - error is a lower bound
+};
+
+// Space-Saving top-k summary holding at most `capacity` counters in an
+// indexed min-heap. Any value more frequent than n / capacity is retained,
+// and counts are exact for as long as nothing has been evicted.
+class HeavyHitters {
+public:
+    explicit HeavyHitters(std::size_t capacity = 1024);
+
+    void add(const std::string& value, std::size_t weight = 1);
+    void merge(const HeavyHitters& other);
+
+    bool exact() const { return !evicted; }
+    std::size_t size() const { return heap.size(); }
+
+    // Most frequent values, highest count first
+    std::vector<HeavyHitter> top(std::size_t n) const;
+
+private:
+    std::size_t capacity;
+    bool evicted;
+    std::vector<HeavyHitter> heap;                          // min-heap on count
+    std::unordered_map<std::string, std::size_t> position;  // value -> heap slot
+
+    void sift_down(std::size_t slot);
+    void swap_slots(std::size_t a, std::size_t b);
+};
+
+#endif // SKETCHES_H
@@ -0,0 +1,318 @@
+#include "sorting.h"
+#include "columns.h"
+#include "parallel.h"
+#include "timestamps.h"
+#include <cstring>
+
+namespace {
+
+// Elements per chunk for the radix passes
+const size_t RADIX_GRAIN = 1 << 16;
+const size_t RADIX_BUCKETS = 256;
+// Rows per chunk for top-k candidate heaps
+const size_t SELECT_GRAIN = 1 << 15;
+
+typedef pair<uint64_t, size_t> KeyedRow;
+
+string trim(const string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == string::npos) return "";
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+int header_index(const vector<string>& header, const string& name) {
+    for (size_t i = 0; i < header.size(); ++i) {
+        if (header[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+string lowercase(string s) {
+    transform(s.begin(), s.end(), s.begin(), ::tolower);
+    return s;
+}
+
+uint64_t null_code(const SortKey& key) {
+    return key.nulls_first ? 0 : numeric_limits<uint64_t>::max();
+}
+
+vector<uint64_t> encode_numeric(const SortKey& key) {
+    const vector<double>& values = numeric_column(key.column).values;
+    vector<uint64_t> codes(values.size());
+    const uint64_t nulls = null_code(key);
+
+    parallel_for(values.size(), RADIX_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            double v = values[i];
+            if (v != v) {
+                codes[i] = nulls;
+                continue;
+            }
+            if (v == 0) v = 0.0;  // -0.0 sorts with 0.0
+
+            // Negative numbers: flip every bit; positive: flip the sign bit
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            bits = (bits >> 63) ? ~bits : bits | (static_cast<uint64_t>(1) << 63);
+            codes[i] = key.ascending ? bits : ~bits;
+        }
+    });
+    return codes;
+}
+
+// Orders a column of timestamps by instant (seconds since 1970), so ISO
+// dates, date-times with offsets and epoch numbers compare correctly. Empty
+// when a non-null cell does not parse as a timestamp.
+vector<uint64_t> encode_time(const SortKey& key) {
+    // Most text columns fail on their first value; skip the full parse for them
+    for (size_t row = 1; row < dataset.size(); ++row) {
+        const string& cell = dataset[row].data[key.column];
+        int64_t seconds;
+        if (is_null_value(cell)) continue;
+        if (!parse_timestamp(cell, seconds)) return vector<uint64_t>();
+        break;
+    }
+
+    vector<int64_t> times = timestamp_column(key.column);
+    vector<uint64_t> codes(times.size());
+    vector<char> failed(chunk_count(times.size(), RADIX_GRAIN), 0);
+    const uint64_t nulls = null_code(key);
+
+    parallel_for(times.size(), RADIX_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (times[i] == MISSING_TIME) {
+                failed[chunk] |= !is_null_value(dataset[i + 1].data[key.column]);
+                codes[i] = nulls;
+                continue;
+            }
+            // Flipping the sign bit makes two's complement order unsigned
+            uint64_t bits = static_cast<uint64_t>(times[i]) ^ (static_cast<uint64_t>(1) << 63);
+            codes[i] = key.ascending ? bits : ~bits;
+        }
+    });
+    for (char chunk_failed : failed) {
+        if (chunk_failed) return vector<uint64_t>();
+    }
+    return codes;
+}
+
+vector<uint64_t> encode_text(const SortKey& key) {
+    // Dictionary-encode the column, then sort only the distinct values
+    DictionaryColumn column = dictionary_column(key.column);
+    vector<uint32_t> order;
+    for (uint32_t id = 0; id < column.values.size(); ++id) {
+        if (!is_null_value(column.values[id])) order.push_back(id);
+    }
+    sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return column.values[a] < column.values[b]; });
+
+    // Ranks start at 1 so they never collide with the null codes
+    vector<uint64_t> rank(column.values.size(), null_code(key));
+    for (size_t r = 0; r < order.size(); ++r) {
+        rank[order[r]] = key.ascending ? r + 1 : order.size() - r;
+    }
+
+    vector<uint64_t> codes(column.ids.size());
+    parallel_for(codes.size(), RADIX_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) codes[i] = rank[column.ids[i]];
+    });
+    return codes;
+}
+
+// Stable parallel LSD radix sort of (key, row) pairs by key. Bytes that are
+// identical across all keys are skipped, so small ranks take one or two passes.
+void radix_sort_pairs(vector<uint64_t>& keys, vector<size_t>& rows) {
+    const size_t n = keys.size();
+    const size_t chunks = chunk_count(n, RADIX_GRAIN);
+    if (n < 2) return;
+
+    vector<uint64_t> any_set(chunks, 0), all_set(chunks, ~static_cast<uint64_t>(0));
+    parallel_for(n, RADIX_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            any_set[chunk] |= keys[i];
+            all_set[chunk] &= keys[i];
+        }
+    });
+    uint64_t varying = 0, common = ~static_cast<uint64_t>(0);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        varying |= any_set[chunk];
+        common &= all_set[chunk];
+    }
+    varying ^= common;
+
+    vector<uint64_t> keys_out(n);
+    vector<size_t> rows_out(n);
+    vector<size_t> offsets(chunks * RADIX_BUCKETS);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0) continue;
+
+        fill(offsets.begin(), offsets.end(), 0);
+        parallel_for(n, RADIX_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+            size_t* counts = &offsets[chunk * RADIX_BUCKETS];
+            for (size_t i = begin; i < end; ++i) {
+                counts[(keys[i] >> shift) & 0xFF]++;
+            }
+        });
+
+        // Bucket-major prefix sum: chunk c writes its part of bucket b after chunks < c
+        size_t running = 0;
+        for (size_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                size_t count = offsets[chunk * RADIX_BUCKETS + bucket];
+                offsets[chunk * RADIX_BUCKETS + bucket] = running;
+                running += count;
+            }
+        }
+
+        parallel_for(n, RADIX_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+            size_t* next = &offsets[chunk * RADIX_BUCKETS];
+            for (size_t i = begin; i < end; ++i) {
+                size_t pos = next[(keys[i] >> shift) & 0xFF]++;
+                keys_out[pos] = keys[i];
+                rows_out[pos] = rows[i];
+            }
+        });
+
+        keys.swap(keys_out);
+        rows.swap(rows_out);
+    }
+}
+
+} // namespace
+
+bool parse_sort_keys(const vector<string>& header, const string& spec, bool default_ascending,
+                     vector<SortKey>& keys, string& error) {
+    keys.clear();
+    int exact = header_index(header, spec);
+    if (exact != -1) {
+        SortKey key = {static_cast<size_t>(exact), default_ascending, false};
+        keys.push_back(key);
+        return true;
+    }
+
+    stringstream list(spec);
+    string item;
+    while (getline(list, item, ',')) {
+        stringstream words(trim(item));
+        vector<string> parts;
+        string word;
+        while (words >> word) parts.push_back(word);
+
+        SortKey key = {0, default_ascending, false};
+        // Modifiers are read from the end: [asc|desc] [nulls first|last]
+        while (parts.size() > 1) {
+            string last = lowercase(parts.back());
+            string before = lowercase(parts[parts.size() - 2]);
+            if (before == "nulls" && (last == "first" || last == "last")) {
+                key.nulls_first = last == "first";
+                parts.resize(parts.size() - 2);
+            } else if (last == "asc" || last == "ascending") {
+                key.ascending = true;
+                parts.pop_back();
+            } else if (last == "desc" || last == "descending") {
+                key.ascending = false;
+                parts.pop_back();
+            } else {
+                break;
+            }
+        }
+
+        string name;
+        for (size_t i = 0; i < parts.size(); ++i) {
+            name += (i ? " " : "") + parts[i];
+        }
+        int index = header_index(header, name);
+        if (index == -1) {
+            error = "Column not found: " + name;
+            return false;
+        }
+        key.column = index;
+        keys.push_back(key);
+    }
+
+    if (keys.empty()) {
+        error = "No sort columns given";
+        return false;
+    }
+    return true;
+}
+
+vector<uint64_t> encode_sort_key(const SortKey& key) {
+    if (is_numeric_column(key.column)) return encode_numeric(key);
+    vector<uint64_t> codes = encode_time(key);
+    return codes.empty() ? encode_text(key) : codes;
+}
+
+vector<size_t> sort_permutation(const vector<SortKey>& keys) {
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    vector<size_t> order(rows);
+    for (size_t i = 0; i < rows; ++i) order[i] = i;
+
+    // LSD over keys too: sort by the least significant key first; stability
+    // keeps earlier orderings as tie-breaks for the more significant keys
+    for (size_t k = keys.size(); k-- > 0;) {
+        vector<uint64_t> codes = encode_sort_key(keys[k]);
+        vector<uint64_t> gathered(rows);
+        parallel_for(rows, RADIX_GRAIN, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                gathered[i] = codes[order[i]];
+            }
+        });
+        radix_sort_pairs(gathered, order);
+    }
+    return order;
+}
+
+vector<size_t> top_k_rows(const SortKey& key, size_t k) {
+    vector<uint64_t> codes = encode_sort_key(key);
+    const uint64_t nulls = null_code(key);
+
+    // Max-heap per chunk holding its k best (code, row) pairs; comparing the
+    // row too keeps ties in dataset order
+    vector<vector<KeyedRow>> heaps(chunk_count(codes.size(), SELECT_GRAIN));
+    parallel_for(codes.size(), SELECT_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        vector<KeyedRow>& heap = heaps[chunk];
+        heap.reserve(min(k, end - begin));
+        for (size_t i = begin; i < end && k > 0; ++i) {
+            if (codes[i] == nulls) continue;
+            KeyedRow candidate(codes[i], i);
+            if (heap.size() < k) {
+                heap.push_back(candidate);
+                push_heap(heap.begin(), heap.end());
+            } else if (candidate < heap.front()) {
+                pop_heap(heap.begin(), heap.end());
+                heap.back() = candidate;
+                push_heap(heap.begin(), heap.end());
+            }
+        }
+    });
+
+    vector<KeyedRow> candidates;
+    for (size_t chunk = 0; chunk < heaps.size(); ++chunk) {
+        candidates.insert(candidates.end(), heaps[chunk].begin(), heaps[chunk].end());
+    }
+    size_t count = min(k, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+    vector<size_t> rows(count);
+    for (size_t i = 0; i < count; ++i) rows[i] = candidates[i].second;
+    return rows;
+}
+
+bool nth_row(const SortKey& key, size_t n, size_t& row) {
+    vector<uint64_t> codes = encode_sort_key(key);
+    const uint64_t nulls = null_code(key);
+
+    vector<KeyedRow> values;
+    values.reserve(codes.size());
+    for (size_t i = 0; i < codes.size(); ++i) {
+        if (codes[i] == nulls) continue;
+        values.push_back(KeyedRow(codes[i], i));
+    }
+    if (n >= values.size()) return false;
+
+    nth_element(values.begin(), values.begin() + n, values.end());
+    row = values[n].second;
+    return true;
+}
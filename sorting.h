@@ -0,0 +1,41 @@
+#ifndef SORTING_H
+#define SORTING_H
+
+#include "main.h"
+#include <cstdint>
+
+// One sort key: a column plus its direction and where its nulls go
+struct SortKey {
+    size_t column;
+    bool ascending;
+    bool nulls_first;
+};
+
+// Parses a key list such as "Region, Sales desc nulls first". Keys without a
+// direction use default_ascending; nulls sort last unless asked otherwise.
+// A spec naming one existing column exactly is always taken as that column.
+// Column names are looked up in header.
+bool parse_sort_keys(const vector<string>& header, const string& spec, bool default_ascending,
+                     vector<SortKey>& keys, string& error);
+
+// Encodes a key column as order-preserving unsigned integers, one per data row:
+// numeric columns by flipping the IEEE bits, columns of timestamps by instant,
+// other text columns by dictionary rank.
+// Direction and null placement are folded in, so ascending integer order is
+// the requested order.
+vector<uint64_t> encode_sort_key(const SortKey& key);
+
+// Stable order of the data rows under keys (most significant first), found
+// with a parallel LSD radix sort over the encoded keys
+vector<size_t> sort_permutation(const vector<SortKey>& keys);
+
+// The (at most) k non-null data rows that come first under key, in order.
+// Each chunk keeps a bounded heap of k candidates (O(n log k)) and the
+// candidates are merged at the end; the dataset is not reordered.
+vector<size_t> top_k_rows(const SortKey& key, size_t k);
+
+// Data row holding the n-th (0-based) non-null value under key, found with
+// nth_element in O(n). False when the column has n or fewer non-null values.
+bool nth_row(const SortKey& key, size_t n, size_t& row);
+
+#endif // SORTING_H
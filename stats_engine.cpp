@@ -0,0 +1,410 @@
+#include "stats_engine.h"
+#include "parallel.h"
+#include "columns.h"
+#include "follow.h"
+#include "kernels.h"
+#include <unordered_map>
+
+void RunningStats::add(double x) {
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    m2 += delta * (x - mean);
+    if (x < min) min = x;
+    if (x > max) max = x;
+}
+
+void RunningStats::merge(const RunningStats& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+
+    // Chan et al. pairwise update
+    double total = static_cast<double>(count + other.count);
+    double delta = other.mean - mean;
+    mean += delta * (other.count / total);
+    m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / total);
+    count += other.count;
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+}
+
+double RunningStats::variance() const {
+    return count ? m2 / count : 0.0;
+}
+
+double RunningStats::std_dev() const {
+    return sqrt(variance());
+}
+
+namespace {
+
+// Rows per chunk below which splitting the pass is not worth a thread
+const size_t PROFILE_GRAIN = 4096;
+
+// Rows packed per block and columns per accumulator tile in compute_covariance_matrix
+const size_t MOMENT_ROW_BLOCK = 256;
+const size_t MOMENT_TILE = 64;
+
+// Counters kept by the Space-Saving summary behind profile_distinct
+const size_t HEAVY_HITTER_CAPACITY = 1024;
+
+// Partial profile of one column over one chunk of rows
+struct ColumnPartial {
+    RunningStats stats;
+    size_t nulls = 0;
+    bool categorical = false;              // chunk saw a non-null, non-numeric cell
+    QuantileSketch sketch;                 // numeric values for the quartiles
+    HeavyHitters counts;                   // every non-null cell, once the chunk is categorical
+
+    ColumnPartial(double epsilon, size_t capacity) : sketch(epsilon), counts(capacity) {}
+};
+
+void count_cells(size_t col, size_t begin, size_t end, HeavyHitters& counts) {
+    for (size_t row = begin; row < end; ++row) {
+        const string& cell = dataset[row + 1].data[col];
+        if (!is_null_value(cell)) counts.add(cell);
+    }
+}
+
+} // namespace
+
+vector<ColumnProfile> profile_columns() {
+    vector<ColumnProfile> profiles;
+    if (dataset.empty()) return profiles;
+
+    const size_t cols = dataset[0].data.size();
+    const size_t rows = dataset.size() - 1;
+    const size_t chunks = chunk_count(rows, PROFILE_GRAIN);
+    const size_t top_n = static_cast<size_t>(max_display_values);
+    const size_t capacity = max(HEAVY_HITTER_CAPACITY, 4 * top_n);
+    vector<vector<ColumnPartial>> partials(chunks, vector<ColumnPartial>(cols, ColumnPartial(quantile_epsilon, capacity)));
+    vector<pair<size_t, size_t>> bounds(chunks);
+
+    // Single pass: every cell is parsed once, row by row
+    parallel_for(rows, PROFILE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        vector<ColumnPartial>& part = partials[chunk];
+        bounds[chunk] = make_pair(begin, end);
+        for (size_t row = begin; row < end; ++row) {
+            const vector<string>& cells = dataset[row + 1].data;
+            for (size_t col = 0; col < cols; ++col) {
+                ColumnPartial& p = part[col];
+                const string& cell = cells[col];
+                if (is_null_value(cell)) {
+                    p.nulls++;
+                    continue;
+                }
+                if (p.categorical) {
+                    p.counts.add(cell);
+                    continue;
+                }
+
+                double value;
+                if (parse_double(cell, value)) {
+                    p.stats.add(value);
+                    p.sketch.add(value);
+                } else {
+                    // First text cell: count the rows this chunk has already passed
+                    p.categorical = true;
+                    p.sketch = QuantileSketch(quantile_epsilon);
+                    count_cells(col, begin, row + 1, p.counts);
+                }
+            }
+        }
+    });
+
+    profiles.resize(cols);
+    vector<pair<size_t, size_t>> recounts;  // (chunk, column) seen as all-numeric in a text column
+    for (size_t col = 0; col < cols; ++col) {
+        ColumnProfile& profile = profiles[col];
+        profile.name = dataset[0].data[col];
+        bool categorical = false;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            profile.nulls += partials[chunk][col].nulls;
+            categorical = categorical || partials[chunk][col].categorical;
+        }
+        profile.numeric = !categorical && profile.nulls < rows;
+        if (!profile.numeric) {
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                if (!partials[chunk][col].categorical) recounts.push_back(make_pair(chunk, col));
+            }
+        }
+    }
+
+    parallel_for(recounts.size(), 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t chunk = recounts[i].first, col = recounts[i].second;
+            ColumnPartial& p = partials[chunk][col];
+            p.sketch = QuantileSketch(quantile_epsilon);
+            count_cells(col, bounds[chunk].first, bounds[chunk].second, p.counts);
+        }
+    });
+
+    // Merge the chunk partials column by column
+    parallel_for(cols, 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t col = begin; col < end; ++col) {
+            ColumnProfile& profile = profiles[col];
+            if (profile.numeric) {
+                QuantileSketch sketch(quantile_epsilon);
+                for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                    profile.stats.merge(partials[chunk][col].stats);
+                    sketch.merge(partials[chunk][col].sketch);
+                    partials[chunk][col].sketch = QuantileSketch(quantile_epsilon);
+                }
+
+                vector<double> q = sketch.quantiles({0.25, 0.5, 0.75});
+                profile.q1 = q[0];
+                profile.median = q[1];
+                profile.q3 = q[2];
+            } else {
+                HeavyHitters counts(capacity);
+                for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                    counts.merge(partials[chunk][col].counts);
+                    partials[chunk][col].counts = HeavyHitters();
+                }
+                profile.frequent = counts.top(top_n);
+                profile.distinct_exact = counts.exact();
+                profile.distinct = counts.size();
+            }
+        }
+    });
+
+    // Columns with more distinct values than counters get a HyperLogLog
+    // estimate from a pass of their own
+    for (size_t col = 0; col < cols; ++col) {
+        if (!profiles[col].numeric && !profiles[col].distinct_exact) {
+            profiles[col].distinct = profile_distinct(col, false, 0).distinct;
+        }
+    }
+    return profiles;
+}
+
+RunningStats column_stats(size_t col) {
+    struct MaintainedStats : MaintainedState {
+        RowWatermark seen;
+        RunningStats stats;
+    };
+    MaintainedStats fresh;
+    MaintainedStats* entry = maintained_state<MaintainedStats>("column_stats/" + to_string(col));
+    if (!entry) entry = &fresh;
+    const vector<size_t> cols(1, col);
+    const size_t first = entry->seen.covered(cols);
+    if (first == 0) entry->stats = RunningStats();
+
+    // Moments of the new rows in two kernel passes, then one pairwise merge
+    const NumericColumn& column = numeric_column(col);
+    const double* values = column.values.data() + first;
+    const size_t n = column.values.size() - first;
+    SumResult total = kernel_sum(values, n);
+    if (total.count) {
+        RunningStats added;
+        MinMaxResult bounds = kernel_min_max(values, n);
+        added.count = total.count;
+        added.mean = total.sum / total.count;
+        added.m2 = kernel_sum_sq_dev(values, n, added.mean);
+        added.min = bounds.min;
+        added.max = bounds.max;
+        entry->stats.merge(added);
+    }
+    entry->seen.advance(cols);
+    return entry->stats;
+}
+
+QuantileSketch column_sketch(size_t col, double epsilon) {
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    vector<QuantileSketch> partials(chunk_count(rows, PROFILE_GRAIN), QuantileSketch(epsilon));
+
+    parallel_for(rows, PROFILE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            const string& cell = dataset[row + 1].data[col];
+            double value;
+            if (!is_null_value(cell) && parse_double(cell, value)) {
+                partials[chunk].add(value);
+            }
+        }
+    });
+
+    QuantileSketch sketch(epsilon);
+    for (const QuantileSketch& part : partials) {
+        sketch.merge(part);
+    }
+    return sketch;
+}
+
+DistinctProfile profile_distinct(size_t col, bool exact, size_t top_n) {
+    DistinctProfile profile;
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    const size_t chunks = chunk_count(rows, PROFILE_GRAIN);
+    const size_t capacity = max(HEAVY_HITTER_CAPACITY, 4 * top_n);
+    profile.rows = rows;
+
+    vector<size_t> nulls(chunks, 0);
+    vector<HyperLogLog> sketches(exact ? 0 : chunks);
+    vector<HeavyHitters> summaries(exact ? 0 : chunks, HeavyHitters(capacity));
+    vector<unordered_map<string, size_t>> counts(exact ? chunks : 0);
+
+    parallel_for(rows, PROFILE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            const string& cell = dataset[row + 1].data[col];
+            if (is_null_value(cell)) {
+                nulls[chunk]++;
+                continue;
+            }
+            if (exact) {
+                counts[chunk][cell]++;
+            } else {
+                sketches[chunk].add(cell);
+                summaries[chunk].add(cell);
+            }
+        }
+    });
+
+    for (size_t n : nulls) profile.nulls += n;
+
+    if (exact) {
+        unordered_map<string, size_t> merged;
+        for (const auto& part : counts) {
+            for (const auto& entry : part) merged[entry.first] += entry.second;
+        }
+        profile.exact = true;
+        profile.distinct = merged.size();
+        for (const auto& entry : merged) {
+            HeavyHitter hitter = {entry.first, entry.second, 0};
+            profile.frequent.push_back(hitter);
+        }
+        sort(profile.frequent.begin(), profile.frequent.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+            return a.count != b.count ? a.count > b.count : a.value < b.value;
+        });
+        if (profile.frequent.size() > top_n) profile.frequent.resize(top_n);
+        return profile;
+    }
+
+    HyperLogLog sketch;
+    HeavyHitters summary(capacity);
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        sketch.merge(sketches[chunk]);
+        summary.merge(summaries[chunk]);
+    }
+
+    // While no counter was evicted the summary has seen every distinct value
+    profile.exact = summary.exact();
+    profile.distinct = profile.exact ? summary.size() : sketch.estimate();
+    profile.frequent = summary.top(top_n);
+    return profile;
+}
+
+CovarianceMatrix compute_covariance_matrix(const vector<size_t>& cols) {
+    CovarianceMatrix result;
+    const size_t p = cols.size();
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+
+    // Centre every column on its own mean so the raw product sums do not cancel
+    vector<const double*> data(p);
+    vector<double> shift(p);
+    for (size_t i = 0; i < p; ++i) {
+        const NumericColumn& column = numeric_column(cols[i]);
+        data[i] = column.values.data();
+        SumResult total = kernel_sum(column.values.data(), rows);
+        shift[i] = total.count ? total.sum / total.count : 0.0;
+        result.names.push_back(dataset[0].data[cols[i]]);
+    }
+
+    // Per-chunk accumulators, all p x p row-major:
+    //   n[i][j]   = sum m_i m_j        sx[i][j]  = sum z_i m_j
+    //   sxx[i][j] = sum z_i^2 m_j      sxy[i][j] = sum z_i z_j
+    // where z is the centred value (0 when missing) and m its presence mask
+    struct Moments {
+        vector<double> n, sx, sxx, sxy;
+    };
+    const size_t chunks = chunk_count(rows, PROFILE_GRAIN);
+    vector<Moments> partials(chunks);
+
+    parallel_for(rows, PROFILE_GRAIN, [&](size_t chunk, size_t begin, size_t end) {
+        Moments& acc = partials[chunk];
+        acc.n.assign(p * p, 0.0);
+        acc.sx.assign(p * p, 0.0);
+        acc.sxx.assign(p * p, 0.0);
+        acc.sxy.assign(p * p, 0.0);
+
+        vector<double> z(MOMENT_ROW_BLOCK * p), z2(MOMENT_ROW_BLOCK * p), m(MOMENT_ROW_BLOCK * p);
+        for (size_t block = begin; block < end; block += MOMENT_ROW_BLOCK) {
+            size_t len = min(MOMENT_ROW_BLOCK, end - block);
+
+            // Pack the row block row-major so the inner loops run over contiguous columns
+            for (size_t i = 0; i < p; ++i) {
+                const double* column = data[i] + block;
+                for (size_t r = 0; r < len; ++r) {
+                    double v = column[r];
+                    bool present = v == v;
+                    double centred = present ? v - shift[i] : 0.0;
+                    z[r * p + i] = centred;
+                    z2[r * p + i] = centred * centred;
+                    m[r * p + i] = present ? 1.0 : 0.0;
+                }
+            }
+
+            // Rank-1 updates, tiled so each tile of accumulators stays in cache
+            for (size_t ti = 0; ti < p; ti += MOMENT_TILE) {
+                size_t ti_end = min(p, ti + MOMENT_TILE);
+                for (size_t tj = 0; tj < p; tj += MOMENT_TILE) {
+                    size_t tj_end = min(p, tj + MOMENT_TILE);
+                    for (size_t r = 0; r < len; ++r) {
+                        const double* zr = &z[r * p];
+                        const double* z2r = &z2[r * p];
+                        const double* mr = &m[r * p];
+                        for (size_t i = ti; i < ti_end; ++i) {
+                            double zi = zr[i], z2i = z2r[i], mi = mr[i];
+                            double* n_row = &acc.n[i * p];
+                            double* sx_row = &acc.sx[i * p];
+                            double* sxx_row = &acc.sxx[i * p];
+                            double* sxy_row = &acc.sxy[i * p];
+                            for (size_t j = tj; j < tj_end; ++j) {
+                                n_row[j] += mi * mr[j];
+                                sx_row[j] += zi * mr[j];
+                                sxx_row[j] += z2i * mr[j];
+                                sxy_row[j] += zi * zr[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    Moments total;
+    total.n.assign(p * p, 0.0);
+    total.sx.assign(p * p, 0.0);
+    total.sxx.assign(p * p, 0.0);
+    total.sxy.assign(p * p, 0.0);
+    for (const Moments& part : partials) {
+        for (size_t k = 0; k < p * p; ++k) {
+            total.n[k] += part.n[k];
+            total.sx[k] += part.sx[k];
+            total.sxx[k] += part.sxx[k];
+            total.sxy[k] += part.sxy[k];
+        }
+    }
+
+    result.covariance.assign(p * p, numeric_limits<double>::quiet_NaN());
+    result.correlation.assign(p * p, numeric_limits<double>::quiet_NaN());
+    result.counts.assign(p * p, 0);
+    for (size_t i = 0; i < p; ++i) {
+        for (size_t j = 0; j < p; ++j) {
+            size_t ij = i * p + j, ji = j * p + i;
+            double n = total.n[ij];
+            result.counts[ij] = static_cast<size_t>(n);
+            if (n == 0) continue;
+
+            // Moments over the rows where both columns are present
+            double sum_x = total.sx[ij], sum_y = total.sx[ji];
+            double cov = (total.sxy[ij] - sum_x * sum_y / n) / n;
+            double var_x = (total.sxx[ij] - sum_x * sum_x / n) / n;
+            double var_y = (total.sxx[ji] - sum_y * sum_y / n) / n;
+            result.covariance[ij] = cov;
+            result.correlation[ij] = i == j ? 1.0 : cov / sqrt(var_x * var_y);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef STATS_ENGINE_H
+#define STATS_ENGINE_H
+
+#include "main.h"
+#include "sketches.h"
+#include <limits>
+
+// Streaming count/mean/variance/min/max (Welford), mergeable across chunks
+struct RunningStats {
+    size_t count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double min = numeric_limits<double>::infinity();
+    double max = -numeric_limits<double>::infinity();
+
+    void add(double x);
+    void merge(const RunningStats& other);
+    double variance() const;   // population variance, matching the DSL statistics
+    double std_dev() const;
+};
+
+// Summary of one dataset column produced by profile_columns
+struct ColumnProfile {
+    string name;
+    bool numeric = false;        // every non-null cell parses as a number
+    size_t nulls = 0;
+    RunningStats stats;          // numeric columns only
+    double q1 = 0.0, median = 0.0, q3 = 0.0;   // exact or sketch estimates, see quantile_epsilon
+    // Categorical columns: the max_display_values most frequent values (highest
+    // count first) and the number of distinct values, exact while it fits
+    vector<HeavyHitter> frequent;
+    double distinct = 0.0;
+    bool distinct_exact = true;
+};
+
+// Profiles every column of the dataset in one parallel pass over the rows.
+// Quartiles come from QuantileSketch with the global quantile_epsilon; value
+// counts from Space-Saving summaries, so memory stays bounded on columns
+// with many distinct values.
+vector<ColumnProfile> profile_columns();
+
+// Distinct-value summary of one column produced by profile_distinct
+struct DistinctProfile {
+    size_t rows = 0;
+    size_t nulls = 0;
+    bool exact = false;            // distinct count and frequencies are exact
+    double distinct = 0.0;         // exact count or HyperLogLog estimate
+    vector<HeavyHitter> frequent;  // most frequent values, highest count first
+};
+
+// Counts distinct values and the top_n most frequent ones in constant memory
+// (HyperLogLog + Space-Saving), or exactly with a hash table when exact is set
+DistinctProfile profile_distinct(size_t col, bool exact, size_t top_n);
+
+// Pairwise-complete covariance and correlation between numeric columns
+// (population moments, like the single-column statistics)
+struct CovarianceMatrix {
+    vector<string> names;
+    vector<double> covariance;    // row-major, names.size() x names.size()
+    vector<double> correlation;
+    vector<size_t> counts;        // rows where both columns are present
+};
+
+// Computes every pair in one cache-blocked parallel pass over the rows,
+// accumulating X^T X style products of the centred values and their masks
+CovarianceMatrix compute_covariance_matrix(const vector<size_t>& cols);
+
+// Count, mean, variance, min and max of column col's numbers. In a follow
+// session the result is kept, and when rows have only been appended since the
+// last call just the new rows are summed and merged in, so a round never
+// rescans the column.
+RunningStats column_stats(size_t col);
+
+// Streams one column's numeric cells into a quantile sketch (nulls and text skipped)
+QuantileSketch column_sketch(size_t col, double epsilon);
+
+#endif // STATS_ENGINE_H
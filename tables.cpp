@@ -0,0 +1,96 @@
+#include "tables.h"
+#include "columns.h"
+
+namespace {
+
+map<string, vector<CSVRow>> stored_tables;
+string active_name = "main";
+map<string, vector<size_t>> partitions;
+
+} // namespace
+
+void store_table(const string& name, vector<CSVRow>&& rows) {
+    if (name == active_name) {
+        dataset = move(rows);
+        clear_partitions();
+        invalidate_columns();
+        return;
+    }
+    stored_tables[name] = move(rows);
+}
+
+const vector<CSVRow>* find_table(const string& name) {
+    if (name == active_name) return &dataset;
+    auto it = stored_tables.find(name);
+    return it == stored_tables.end() ? nullptr : &it->second;
+}
+
+bool switch_table(const string& name, string& error) {
+    if (name == active_name) return true;
+    auto it = stored_tables.find(name);
+    if (it == stored_tables.end()) {
+        error = "Table not found: " + name;
+        return false;
+    }
+
+    vector<CSVRow> next = move(it->second);
+    stored_tables.erase(it);
+    stored_tables[active_name] = move(dataset);
+    dataset = move(next);
+    active_name = name;
+    clear_partitions();
+    invalidate_columns();
+    return true;
+}
+
+const string& active_table() {
+    return active_name;
+}
+
+vector<string> table_names() {
+    vector<string> names;
+    names.push_back(active_name);
+    for (const auto& table : stored_tables) names.push_back(table.first);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+void store_partition(const string& name, vector<size_t>&& rows) {
+    partitions[name] = move(rows);
+}
+
+bool partition_rows(const string& name, vector<size_t>& rows, string& error) {
+    if (name == "all") {
+        rows.resize(dataset.empty() ? 0 : dataset.size() - 1);
+        for (size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+        return true;
+    }
+    auto it = partitions.find(name);
+    if (it == partitions.end()) {
+        error = "Partition not found: " + name + " (run split_data first)";
+        return false;
+    }
+    rows = it->second;
+    return true;
+}
+
+void reorder_partitions(const vector<size_t>& order, size_t old_rows) {
+    if (partitions.empty()) return;
+    const size_t dropped = numeric_limits<size_t>::max();
+    vector<size_t> position(old_rows, dropped);
+    for (size_t i = 0; i < order.size(); ++i) position[order[i]] = i;
+
+    for (auto& partition : partitions) {
+        vector<size_t> rows;
+        rows.reserve(partition.second.size());
+        for (size_t row : partition.second) {
+            if (position[row] != dropped) rows.push_back(position[row]);
+        }
+        sort(rows.begin(), rows.end());
+        partition.second.swap(rows);
+    }
+}
+
+void clear_partitions() {
+    partitions.clear();
+}
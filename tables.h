@@ -0,0 +1,41 @@
+#ifndef TABLES_H
+#define TABLES_H
+
+#include "main.h"
+
+// Named tables kept next to the active dataset. Operators that build a new
+// table (group_by_data, ...) store it here and use_table() makes it the
+// dataset later statements work on. The loaded data is the table "main".
+
+// Stores rows (header first) under name, replacing the active dataset when
+// name is the active table
+void store_table(const string& name, vector<CSVRow>&& rows);
+
+// The table called name (the dataset itself when it is active), or nullptr
+const vector<CSVRow>* find_table(const string& name);
+
+// Makes name the active dataset; the previous one is kept under its name
+bool switch_table(const string& name, string& error);
+
+const string& active_table();
+
+// Names of all tables, active one included, sorted
+vector<string> table_names();
+
+// Named partitions of the active table (split_data stores "train" and
+// "test"): ascending data row indices into the same rows, never copies.
+// They last until the rows change; reorders carry them along.
+void store_partition(const string& name, vector<size_t>&& rows);
+
+// Rows of partition name, or every data row for "all"; false with error set
+// when no such partition exists
+bool partition_rows(const string& name, vector<size_t>& rows, string& error);
+
+// Moves partitions along with reorder_rows(order) over old_rows data rows;
+// rows left out of order leave their partitions
+void reorder_partitions(const vector<size_t>& order, size_t old_rows);
+
+// Drops all partitions, for operations that replace the active rows
+void clear_partitions();
+
+#endif // TABLES_H
@@ -0,0 +1,254 @@
+#include "timestamps.h"
+#include "parallel.h"
+#include <iomanip>
+
+namespace {
+
+// Rows per parse chunk
+const size_t TIME_GRAIN = 8192;
+const int64_t SECONDS_PER_DAY = 86400;
+const int64_t SECONDS_PER_WEEK = 7 * SECONDS_PER_DAY;
+// 1970-01-05, the first Monday, where week buckets start
+const int64_t FIRST_MONDAY = 4 * SECONDS_PER_DAY;
+
+// Division rounding towards negative infinity
+int64_t floor_div(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Value of the n digits at s, or -1 when one of them is not a digit
+int fixed_digits(const char* s, int n) {
+    int value = 0;
+    for (int i = 0; i < n; ++i) {
+        unsigned d = static_cast<unsigned>(static_cast<unsigned char>(s[i])) - '0';
+        if (d > 9) return -1;
+        value = value * 10 + static_cast<int>(d);
+    }
+    return value;
+}
+
+unsigned days_in_month(int64_t year, unsigned month) {
+    static const unsigned days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+bool parse_epoch(const char* s, size_t n, int64_t& seconds) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < n && (s[i] == '-' || s[i] == '+')) negative = s[i++] == '-';
+
+    size_t start = i;
+    int64_t value = 0;
+    while (i < n && is_digit(s[i])) {
+        if (i - start == 18) return false;
+        value = value * 10 + (s[i++] - '0');
+    }
+    size_t count = i - start;
+    if (count == 0) return false;
+    if (i < n && s[i] == '.') {
+        // Sub-second digits are dropped
+        for (++i; i < n && is_digit(s[i]); ++i) {}
+    }
+    if (i != n) return false;
+
+    if (count >= 13) value /= 1000;
+    seconds = negative ? -value : value;
+    return true;
+}
+
+} // namespace
+
+int64_t days_from_civil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+    const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned day_of_era = static_cast<unsigned>(days - era * 146097);
+    const unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    const unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    const unsigned shifted_month = (5 * day_of_year + 2) / 153;
+    day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+    month = shifted_month < 10 ? shifted_month + 3 : shifted_month - 9;
+    year = static_cast<int64_t>(year_of_era) + era * 400 + (month <= 2);
+}
+
+bool parse_timestamp(const string& text, int64_t& seconds) {
+    const char* s = text.data();
+    const size_t n = text.size();
+    if (n < 10 || s[4] != '-' || s[7] != '-') return parse_epoch(s, n, seconds);
+
+    int year = fixed_digits(s, 4), month = fixed_digits(s + 5, 2), day = fixed_digits(s + 8, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || static_cast<unsigned>(day) > days_in_month(year, month)) {
+        return false;
+    }
+    int64_t t = days_from_civil(year, month, day) * SECONDS_PER_DAY;
+
+    size_t i = 10;
+    if (i < n) {
+        if ((s[i] != 'T' && s[i] != ' ') || i + 6 > n || s[i + 3] != ':') return false;
+        int hour = fixed_digits(s + i + 1, 2), minute = fixed_digits(s + i + 4, 2);
+        if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return false;
+        t += hour * 3600 + minute * 60;
+        i += 6;
+
+        if (i < n && s[i] == ':') {
+            int second = i + 3 <= n ? fixed_digits(s + i + 1, 2) : -1;
+            if (second < 0 || second > 60) return false;
+            t += second;
+            i += 3;
+            if (i < n && (s[i] == '.' || s[i] == ',')) {
+                for (++i; i < n && is_digit(s[i]); ++i) {}
+            }
+        }
+
+        if (i < n && s[i] == 'Z') {
+            ++i;
+        } else if (i < n && (s[i] == '+' || s[i] == '-')) {
+            // Offsets are local time minus UTC
+            int sign = s[i] == '+' ? 1 : -1;
+            int offset_hours = i + 3 <= n ? fixed_digits(s + i + 1, 2) : -1;
+            i += 3;
+            if (i < n && s[i] == ':') ++i;
+            int offset_minutes = 0;
+            if (i < n) {
+                offset_minutes = i + 2 <= n ? fixed_digits(s + i, 2) : -1;
+                i += 2;
+            }
+            if (offset_hours < 0 || offset_hours > 23 || offset_minutes < 0 || offset_minutes > 59) return false;
+            t -= sign * (offset_hours * 3600 + offset_minutes * 60);
+        }
+        if (i != n) return false;
+    }
+
+    seconds = t;
+    return true;
+}
+
+string format_timestamp(int64_t seconds, bool date_only) {
+    int64_t days = seconds / SECONDS_PER_DAY;
+    int64_t rest = seconds % SECONDS_PER_DAY;
+    if (rest < 0) {
+        rest += SECONDS_PER_DAY;
+        days--;
+    }
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+
+    ostringstream out;
+    out << setfill('0') << setw(4) << year << '-' << setw(2) << month << '-' << setw(2) << day;
+    if (!date_only) {
+        out << ' ' << setw(2) << rest / 3600 << ':' << setw(2) << rest / 60 % 60 << ':' << setw(2) << rest % 60;
+    }
+    return out.str();
+}
+
+vector<int64_t> timestamp_column(size_t col) {
+    const size_t rows = dataset.empty() ? 0 : dataset.size() - 1;
+    vector<int64_t> times(rows, MISSING_TIME);
+    parallel_for(rows, TIME_GRAIN, [&](size_t, size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+            if (!parse_timestamp(dataset[row + 1].data[col], times[row])) times[row] = MISSING_TIME;
+        }
+    });
+    return times;
+}
+
+int detect_time_column() {
+    if (dataset.empty()) return -1;
+    const size_t SAMPLE = 64;
+    for (size_t col = 0; col < dataset[0].data.size(); ++col) {
+        // Every sampled cell must parse and one must be an ISO date, so
+        // plain numeric columns are never taken for epoch times
+        bool all_parse = true, iso = false;
+        size_t sampled = 0;
+        for (size_t row = 1; row < dataset.size() && sampled < SAMPLE && all_parse; ++row) {
+            const string& cell = dataset[row].data[col];
+            if (is_null_value(cell)) continue;
+            int64_t seconds;
+            all_parse = parse_timestamp(cell, seconds);
+            iso = iso || (cell.size() >= 10 && cell[4] == '-');
+            sampled++;
+        }
+        if (all_parse && iso) return static_cast<int>(col);
+    }
+    return -1;
+}
+
+bool parse_frequency(const string& text, Frequency& frequency, string& error) {
+    size_t i = text.find_first_not_of(" \t");
+    size_t digits_end = i == string::npos ? i : text.find_first_not_of("0123456789", i);
+    int64_t count = 1;
+    if (i != string::npos && digits_end != i) {
+        count = digits_end - i > 9 ? 0 : stoll(text.substr(i, digits_end - i));
+        i = digits_end;
+    }
+    string unit = i == string::npos ? "" : text.substr(i);
+    unit.erase(0, unit.find_first_not_of(" \t"));
+    unit.erase(unit.find_last_not_of(" \t") + 1);
+
+    static const map<string, int64_t> seconds = {
+        {"s", 1}, {"sec", 1}, {"second", 1}, {"t", 60}, {"min", 60}, {"minute", 60},
+        {"h", 3600}, {"hour", 3600}, {"hourly", 3600}, {"d", SECONDS_PER_DAY}, {"day", SECONDS_PER_DAY},
+        {"daily", SECONDS_PER_DAY}, {"w", SECONDS_PER_WEEK}, {"week", SECONDS_PER_WEEK},
+        {"weekly", SECONDS_PER_WEEK}
+    };
+    static const map<string, int64_t> months = {
+        {"M", 1}, {"MS", 1}, {"month", 1}, {"monthly", 1}, {"q", 3}, {"quarter", 3}, {"quarterly", 3},
+        {"y", 12}, {"year", 12}, {"yearly", 12}, {"annual", 12}, {"annually", 12}
+    };
+
+    frequency = Frequency();
+    if (count > 0 && months.count(unit)) {
+        frequency.months = count * months.at(unit);
+        return true;
+    }
+    string name = unit;
+    transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+    if (name.size() > 3 && name.back() == 's') name.pop_back();
+    if (count > 0 && seconds.count(name)) {
+        frequency.seconds = count * seconds.at(name);
+        return true;
+    }
+    if (count > 0 && months.count(name)) {
+        frequency.months = count * months.at(name);
+        return true;
+    }
+
+    error = "Unknown frequency: " + text + " (use e.g. second, 15min, hour, day, week, month, year or daily, monthly)";
+    return false;
+}
+
+int64_t bucket_number(int64_t t, const Frequency& frequency) {
+    if (frequency.months == 0) {
+        int64_t origin = frequency.seconds % SECONDS_PER_WEEK == 0 ? FIRST_MONDAY : 0;
+        return floor_div(t - origin, frequency.seconds);
+    }
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(floor_div(t, SECONDS_PER_DAY), year, month, day);
+    return floor_div(year * 12 + month - 1, frequency.months);
+}
+
+int64_t bucket_time(int64_t number, const Frequency& frequency) {
+    if (frequency.months == 0) {
+        int64_t origin = frequency.seconds % SECONDS_PER_WEEK == 0 ? FIRST_MONDAY : 0;
+        return number * frequency.seconds + origin;
+    }
+    int64_t month_index = number * frequency.months;
+    int64_t year = floor_div(month_index, 12);
+    return days_from_civil(year, static_cast<unsigned>(month_index - year * 12 + 1), 1) * SECONDS_PER_DAY;
+}
@@ -0,0 +1,48 @@
+#ifndef TIMESTAMPS_H
+#define TIMESTAMPS_H
+
+#include "main.h"
+#include <cstdint>
+#include <limits>
+
+// Marks a cell that is null or does not parse as a timestamp
+const int64_t MISSING_TIME = numeric_limits<int64_t>::min();
+
+// Days since 1970-01-01 of a proleptic Gregorian date, and back
+int64_t days_from_civil(int64_t year, unsigned month, unsigned day);
+void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day);
+
+// Parses an ISO-8601 date or date-time (YYYY-MM-DD, then optionally T or a
+// space, hh:mm[:ss[.fff]] and Z or a +hh:mm / -hhmm offset) or an epoch
+// number (seconds, or milliseconds when it has 13 or more digits) into
+// seconds since 1970-01-01 UTC. Digits are read at fixed positions with plain
+// arithmetic, without strptime, locales or allocation.
+bool parse_timestamp(const string& text, int64_t& seconds);
+
+// "YYYY-MM-DD hh:mm:ss", or just the date
+string format_timestamp(int64_t seconds, bool date_only);
+
+// Parses column col in parallel; MISSING_TIME where a cell does not parse
+vector<int64_t> timestamp_column(size_t col);
+
+// First column whose leading non-null cells all parse as timestamps, at
+// least one of them an ISO date; -1 when there is none
+int detect_time_column();
+
+// Width of a time bucket: a number of seconds or of calendar months
+struct Frequency {
+    int64_t seconds = 0;
+    int64_t months = 0;
+};
+
+// Parses frequencies such as "minute", "15min", "2 hours", "day", "week",
+// "month", "3M" or "year", and the adverbs hourly, daily, weekly, monthly,
+// quarterly and yearly
+bool parse_frequency(const string& text, Frequency& frequency, string& error);
+
+// Number of the bucket holding t, counting from 1970 (weeks start on Monday,
+// months on the 1st), and the time bucket number starts at
+int64_t bucket_number(int64_t t, const Frequency& frequency);
+int64_t bucket_time(int64_t number, const Frequency& frequency);
+
+#endif // TIMESTAMPS_H
@@ -2,13 +2,14 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <regex>
 #include <set>
 
 // Set of valid function names
 const std::set<std::string> valid_functions = {
     // File Operations
-    "load_csv", "save_csv", "describe_data",
+    "load_csv", "save_csv", "describe_data", "follow",
     
     // Data Cleaning
     "remove_nulls", "fill_nulls", "rename_column", "add_column",
@@ -18,24 +19,46 @@ const std::set<std::string> valid_functions = {
     
     // Statistics
     "mean", "correlation", "standard_deviation", "median", "variance",
+    "quantile", "percentiles", "quantile_accuracy",
+    "correlation_matrix", "covariance_matrix",
     
     // Machine Learning
-    "train_model", "predict", "save_model", "evaluate_model",
+    "train_model", "predict", "save_model", "load_model", "evaluate_model",
+    "train_model_csv", "sgd_options", "cross_validate", "grid_search",
+    "kmeans",
     
     // Text Processing
     "remove_stopwords", "stem_text", "capitalize_words", "count_words",
     
     // Time Series
-    "rolling_mean", "resample_data", "detect_trends", "seasonal_decompose",
+    "rolling_mean", "window", "resample_data", "detect_trends", "seasonal_decompose",
+    "autocorrelation",
     "detect_anomalies",
     
     // Data Transformation
-    "normalize", "standardize", "split_data", "drop_column", "filter_rows",
-    "sort_data", "group_by_data", "scale_data",
+    "normalize", "standardize", "split_data", "drop_column", "filter_rows", "filter",
+    "create_index", "sort_data", "sort_csv", "sort_memory", "top_k", "nth_value",
+    "group_by_data", "use_table", "list_tables", "join", "scale_data",
     
     // Profiling & Analysis
     "get_shape", "data_quality_report", "get_column_profile",
-    "categorize_column", "pivot_table", "describe", "print"
+    "categorize_column", "pivot_table", "describe", "display_limit", "print"
+};
+
+// Functions that narrow the lazy view, and the ones that read through it;
+// every other call sees the dataset after materialize_view()
+const std::set<std::string> view_producers = {
+    "filter", "filter_rows", "remove_nulls", "drop_column"
+};
+const std::set<std::string> view_readers = {
+    "load_csv", "save_csv", "get_shape", "print", "display_limit",
+    "quantile_accuracy", "sort_memory", "sort_csv", "train_model_csv", "sgd_options"
+};
+
+// String parameters that take values which may look numeric (a fill value,
+// a list of alphas); their arguments are always quoted
+const std::map<std::string, std::set<std::size_t>> string_parameters = {
+    {"fill_nulls", {0}}, {"filter_rows", {1}}, {"grid_search", {0, 1}}, {"print", {0}}
 };
 
 // Check if a function name is valid
@@ -53,8 +76,10 @@ std::vector<Token> tokenize(const std::string& code) {
     while (std::getline(ss, line)) {
         line_number++;
         
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#') continue;
+        // Skip empty lines and comments (# or //), allowing indentation
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty() || line[0] == '#' || line.compare(0, 2, "//") == 0) continue;
 
         // Regular expression to match function calls with both string and numeric arguments
         std::regex func_pattern("(\\w+)\\s*\\((.*)\\)");
@@ -145,17 +170,32 @@ void generate_function_call(std::ofstream& out, const Token& token) {
             }
         }
         out << "}";
+    } else if (token.function_name == "percentiles") {
+        // Column name followed by any number of percentiles
+        out << "\"" << token.arguments[0] << "\", {";
+        for (std::size_t i = 1; i < token.arguments.size(); ++i) {
+            out << token.arguments[i];
+            if (i < token.arguments.size() - 1) {
+                out << ", ";
+            }
+        }
+        out << "}";
     } else {
         // Handle other function calls with proper type detection
+        auto strings = string_parameters.find(token.function_name);
         for (std::size_t i = 0; i < token.arguments.size(); ++i) {
             const std::string& arg = token.arguments[i];
             
+            // Declared string parameters keep their text
+            if (strings != string_parameters.end() && strings->second.count(i)) {
+                out << "\"" << arg << "\"";
+            }
             // Check if it's a boolean
-            if (arg == "true" || arg == "false") {
+            else if (arg == "true" || arg == "false") {
                 out << arg;
             }
             // Check if it's a number (integer or float)
-            else if (std::all_of(arg.begin(), arg.end(), [](char c) {
+            else if (!arg.empty() && std::all_of(arg.begin(), arg.end(), [](char c) {
                 return std::isdigit(c) || c == '.' || c == '-';
             })) {
                 out << arg;
@@ -183,16 +223,33 @@ void parse_and_generate(const std::vector<Token>& tokens) {
 
     // Write includes and using directive
     out << "#include \"main.h\"" << std::endl;
+    out << "#include \"view.h\"" << std::endl;
+    out << "#include \"follow.h\"" << std::endl;
     out << "using namespace std;" << std::endl << std::endl;
 
     // Generate main function
     out << "int main() {" << std::endl;
     out << "    try {" << std::endl;
 
-    // Generate function calls
+    // Generate function calls, materialising a pending view only where a
+    // call needs the rows in place. The statements after follow() repeat,
+    // with newly appended rows, until follow_tick() has used up its rounds.
+    bool view_pending = false, following = false;
     for (const auto& token : tokens) {
+        const std::string& name = token.function_name;
+        if (view_producers.count(name)) {
+            view_pending = true;
+        } else if (view_pending && !view_readers.count(name)) {
+            out << "    materialize_view();" << std::endl;
+            view_pending = false;
+        }
         generate_function_call(out, token);
+        if (name == "follow" && !following) {
+            out << "    do {" << std::endl;
+            following = true;
+        }
     }
+    if (following) out << "    } while (follow_tick());" << std::endl;
 
     // Close main function
     out << "        return 0;" << std::endl;
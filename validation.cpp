@@ -0,0 +1,59 @@
+#include "validation.h"
+#include "columns.h"
+#include "parallel.h"
+#include <chrono>
+#include <random>
+
+bool fit_model(const TrainingSpec& spec, const vector<size_t>& rows, Model& model, string& error) {
+    if (spec.method == "normal") return fit_linear(spec.features, spec.target, rows, spec.alpha, model, error);
+    SgdReport report;
+    return fit_sgd(spec.features, spec.target, rows, spec.alpha, spec.method == "logistic", spec.sgd, model, report,
+                   error);
+}
+
+vector<vector<FoldResult>> cross_validate_specs(const vector<TrainingSpec>& specs, const vector<size_t>& rows,
+                                                size_t k, unsigned seed) {
+    // Fold f holds every k-th row of the shuffled order from position f
+    vector<size_t> order(rows);
+    mt19937_64 rng(seed);
+    for (size_t i = order.size(); i > 1; --i) swap(order[i - 1], order[rng() % i]);
+    vector<vector<size_t>> folds(k);
+    for (size_t i = 0; i < order.size(); ++i) folds[i % k].push_back(order[i]);
+    for (vector<size_t>& fold : folds) sort(fold.begin(), fold.end());
+
+    // The workers only read the column cache, so it is filled here first
+    for (const TrainingSpec& spec : specs) {
+        for (size_t col : spec.features) numeric_column(col);
+        numeric_column(spec.target);
+    }
+
+    // One task per (spec, fold); fits inside a task run serially
+    vector<vector<FoldResult>> results(specs.size(), vector<FoldResult>(k));
+    parallel_for(specs.size() * k, 1, [&](size_t, size_t begin, size_t end) {
+        for (size_t task = begin; task < end; ++task) {
+            const TrainingSpec& spec = specs[task / k];
+            const size_t f = task % k;
+            FoldResult& result = results[task / k][f];
+            auto start = chrono::steady_clock::now();
+
+            vector<size_t> train;
+            train.reserve(rows.size() - folds[f].size());
+            for (size_t other = 0; other < k; ++other) {
+                if (other != f) train.insert(train.end(), folds[other].begin(), folds[other].end());
+            }
+            result.train_rows = train.size();
+
+            Model model;
+            result.ok = fit_model(spec, train, model, result.error);
+            if (result.ok) {
+                vector<const double*> x;
+                for (size_t col : spec.features) x.push_back(numeric_column(col).values.data());
+                vector<double> predicted(folds[f].size());
+                for (size_t i = 0; i < predicted.size(); ++i) predicted[i] = model_prediction(model, x, folds[f][i]);
+                result.metrics = model_metrics(model, predicted, numeric_column(spec.target).values.data(), folds[f]);
+            }
+            result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        }
+    });
+    return results;
+}
@@ -0,0 +1,37 @@
+#ifndef VALIDATION_H
+#define VALIDATION_H
+
+#include "main.h"
+#include "models.h"
+#include "sgd.h"
+
+// What to train: the fitting method and hyperparameters for one model
+struct TrainingSpec {
+    vector<size_t> features;
+    size_t target = 0;
+    string method = "normal";  // normal, sgd or logistic
+    double alpha = 0.0;
+    SgdOptions sgd;
+};
+
+// Trains spec on rows, which must be complete, with fit_linear or fit_sgd
+bool fit_model(const TrainingSpec& spec, const vector<size_t>& rows, Model& model, string& error);
+
+// One fold of a cross-validation: trained on the other folds, scored on this one
+struct FoldResult {
+    size_t train_rows = 0;
+    ModelMetrics metrics;
+    double seconds = 0.0;     // training and scoring time
+    bool ok = false;
+    string error;
+};
+
+// k-fold cross-validation of every spec over rows (complete for all of
+// them). Rows are dealt into k folds after a seeded shuffle, the same folds
+// for every spec, and each (spec, fold) pair is trained on its own worker
+// thread. Folds are index lists into the shared columns, never copies.
+// Returns one vector of k fold results per spec.
+vector<vector<FoldResult>> cross_validate_specs(const vector<TrainingSpec>& specs, const vector<size_t>& rows,
+                                                size_t k, unsigned seed);
+
+#endif // VALIDATION_H
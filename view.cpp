@@ -0,0 +1,66 @@
+#include "view.h"
+#include "columns.h"
+
+namespace {
+
+bool rows_selected = false;       // otherwise every data row is in the view
+vector<size_t> selected_rows;
+bool columns_projected = false;   // otherwise every column is in the view
+vector<size_t> projected_columns;
+
+size_t data_rows() {
+    return dataset.empty() ? 0 : dataset.size() - 1;
+}
+
+} // namespace
+
+bool view_active() {
+    return rows_selected || columns_projected;
+}
+
+size_t view_row_count() {
+    return rows_selected ? selected_rows.size() : data_rows();
+}
+
+vector<size_t> view_rows() {
+    if (rows_selected) return selected_rows;
+    vector<size_t> rows(data_rows());
+    for (size_t i = 0; i < rows.size(); ++i) rows[i] = i;
+    return rows;
+}
+
+vector<size_t> view_columns() {
+    if (columns_projected) return projected_columns;
+    vector<size_t> cols(dataset.empty() ? 0 : dataset[0].data.size());
+    for (size_t i = 0; i < cols.size(); ++i) cols[i] = i;
+    return cols;
+}
+
+void select_view_rows(vector<size_t>&& rows) {
+    selected_rows = move(rows);
+    rows_selected = true;
+}
+
+void drop_view_column(size_t col) {
+    if (!columns_projected) {
+        projected_columns = view_columns();
+        columns_projected = true;
+    }
+    projected_columns.erase(remove(projected_columns.begin(), projected_columns.end(), col), projected_columns.end());
+}
+
+void materialize_view() {
+    // Rows first, so the column pass only touches the rows that survive
+    if (rows_selected && selected_rows.size() != data_rows()) reorder_rows(selected_rows);
+    if (columns_projected && !dataset.empty() && projected_columns.size() != dataset[0].data.size()) {
+        project_columns(projected_columns);
+    }
+    discard_view();
+}
+
+void discard_view() {
+    rows_selected = false;
+    columns_projected = false;
+    vector<size_t>().swap(selected_rows);
+    projected_columns.clear();
+}
@@ -0,0 +1,32 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include "main.h"
+
+// Lazy view over the dataset: the data rows and columns that are logically
+// present. filter, filter_rows, remove_nulls and drop_column only narrow the
+// view, in O(selected rows) or O(columns) with no string copies; the dataset
+// itself is rewritten once, by materialize_view(), before a statement that
+// reads it directly. The generated program inserts that call.
+
+// True while the dataset holds rows or columns outside the view
+bool view_active();
+
+// Data rows (0-based, ascending) and columns in the view
+size_t view_row_count();
+vector<size_t> view_rows();
+vector<size_t> view_columns();
+
+// Narrows the view to rows, a subset of view_rows()
+void select_view_rows(vector<size_t>&& rows);
+
+// Removes a dataset column from the view
+void drop_view_column(size_t col);
+
+// Moves the rows and cells in the view into place and drops the rest
+void materialize_view();
+
+// Forgets the view, e.g. when the dataset is replaced
+void discard_view();
+
+#endif // VIEW_H
@@ -0,0 +1,173 @@
+#include "window_functions.h"
+#include "parallel.h"
+#include <cmath>
+#include <deque>
+#include <limits>
+
+namespace {
+
+const double NaN = numeric_limits<double>::quiet_NaN();
+
+// Groups per parallel task
+const size_t GROUP_GRAIN = 16;
+
+bool present(double x) {
+    return x == x;
+}
+
+// Sliding sum, mean or variance. Sums are kept relative to the first number
+// of the series, which keeps the variance stable for large offsets, and are
+// reset whenever the window empties so rounding cannot build up.
+void sliding_moments(const double* x, size_t n, WindowKind kind, size_t size, double* out) {
+    double shift = NaN, sum = 0.0, sum_sq = 0.0;
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (present(x[i])) {
+            if (!present(shift)) shift = x[i];
+            double d = x[i] - shift;
+            sum += d;
+            sum_sq += d * d;
+            count++;
+        }
+        if (i >= size && present(x[i - size])) {
+            double d = x[i - size] - shift;
+            sum -= d;
+            sum_sq -= d * d;
+            if (--count == 0) sum = sum_sq = 0.0;
+        }
+
+        if (i + 1 < size || count == 0) {
+            out[i] = NaN;
+        } else if (kind == WINDOW_SUM) {
+            out[i] = sum + count * shift;
+        } else if (kind == WINDOW_MEAN) {
+            out[i] = shift + sum / count;
+        } else {
+            out[i] = max(0.0, (sum_sq - sum * sum / count) / count);
+        }
+    }
+}
+
+// Sliding min or max: the deque holds the positions that can still become
+// the extreme, their values monotonic from front to back
+void sliding_extreme(const double* x, size_t n, bool want_max, size_t size, double* out) {
+    deque<size_t> candidates;
+    for (size_t i = 0; i < n; ++i) {
+        if (present(x[i])) {
+            while (!candidates.empty() && (want_max ? x[candidates.back()] <= x[i] : x[candidates.back()] >= x[i])) {
+                candidates.pop_back();
+            }
+            candidates.push_back(i);
+        }
+        while (!candidates.empty() && candidates.front() + size <= i) candidates.pop_front();
+        out[i] = (i + 1 < size || candidates.empty()) ? NaN : x[candidates.front()];
+    }
+}
+
+void evaluate_series(const double* x, size_t n, WindowKind kind, size_t size, double* out) {
+    switch (kind) {
+        case WINDOW_SUM:
+        case WINDOW_MEAN:
+        case WINDOW_VARIANCE:
+            sliding_moments(x, n, kind, size, out);
+            break;
+        case WINDOW_MIN:
+        case WINDOW_MAX:
+            sliding_extreme(x, n, kind == WINDOW_MAX, size, out);
+            break;
+        case WINDOW_EWMA: {
+            const double alpha = 2.0 / (size + 1.0);
+            double smoothed = NaN;
+            for (size_t i = 0; i < n; ++i) {
+                if (present(x[i])) smoothed = present(smoothed) ? alpha * x[i] + (1 - alpha) * smoothed : x[i];
+                out[i] = smoothed;
+            }
+            break;
+        }
+        case WINDOW_LAG:
+            for (size_t i = 0; i < n; ++i) out[i] = i >= size ? x[i - size] : NaN;
+            break;
+        case WINDOW_DIFF:
+            for (size_t i = 0; i < n; ++i) out[i] = i >= size ? x[i] - x[i - size] : NaN;
+            break;
+        case WINDOW_CUMSUM: {
+            double sum = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                if (present(x[i])) sum += x[i];
+                out[i] = present(x[i]) ? sum : NaN;
+            }
+            break;
+        }
+    }
+}
+
+} // namespace
+
+bool find_window_function(const string& name, WindowKind& kind) {
+    static const map<string, WindowKind> functions = {
+        {"sum", WINDOW_SUM}, {"mean", WINDOW_MEAN}, {"avg", WINDOW_MEAN}, {"variance", WINDOW_VARIANCE},
+        {"min", WINDOW_MIN}, {"max", WINDOW_MAX}, {"ewma", WINDOW_EWMA}, {"lag", WINDOW_LAG},
+        {"diff", WINDOW_DIFF}, {"cumsum", WINDOW_CUMSUM}
+    };
+    auto it = functions.find(name);
+    if (it == functions.end()) return false;
+    kind = it->second;
+    return true;
+}
+
+vector<double> window_function(const vector<double>& values, const vector<uint32_t>* groups, size_t group_count,
+                               WindowKind kind, size_t size) {
+    vector<double> result(values.size(), NaN);
+    if (!groups) {
+        evaluate_series(values.data(), values.size(), kind, size, result.data());
+        return result;
+    }
+
+    // Bucket the rows by group, keeping row order inside each group
+    vector<size_t> offsets(group_count + 1, 0);
+    for (uint32_t id : *groups) offsets[id + 1]++;
+    for (size_t g = 0; g < group_count; ++g) offsets[g + 1] += offsets[g];
+    vector<size_t> rows(values.size());
+    vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t row = 0; row < values.size(); ++row) rows[next[(*groups)[row]]++] = row;
+
+    parallel_for(group_count, GROUP_GRAIN, [&](size_t, size_t begin, size_t end) {
+        vector<double> series, out;
+        for (size_t g = begin; g < end; ++g) {
+            size_t n = offsets[g + 1] - offsets[g];
+            series.resize(n);
+            out.resize(n);
+            for (size_t i = 0; i < n; ++i) series[i] = values[rows[offsets[g] + i]];
+            evaluate_series(series.data(), n, kind, size, out.data());
+            for (size_t i = 0; i < n; ++i) result[rows[offsets[g] + i]] = out[i];
+        }
+    });
+    return result;
+}
+
+void extend_window_function(const vector<double>& values, WindowKind kind, size_t size, vector<double>& result) {
+    const size_t start = min(result.size(), values.size());
+    result.resize(values.size(), NaN);
+    if (start == values.size()) return;
+
+    size_t from = start;
+    double total = 0.0;
+    if (kind == WINDOW_EWMA) {
+        from = start > 0 ? start - 1 : 0;
+    } else if (kind == WINDOW_CUMSUM) {
+        for (size_t i = start; i-- > 0;) {
+            if (present(result[i])) {
+                total = result[i];
+                break;
+            }
+        }
+    } else {
+        from = start > size ? start - size : 0;
+    }
+
+    vector<double> series(values.begin() + from, values.end()), out(series.size());
+    // Seeding with the previous smoothed value continues the average exactly
+    if (kind == WINDOW_EWMA && from < start) series[0] = result[from];
+    evaluate_series(series.data(), series.size(), kind, size, out.data());
+    for (size_t i = start; i < values.size(); ++i) result[i] = kind == WINDOW_CUMSUM ? out[i - from] + total : out[i - from];
+}
@@ -0,0 +1,36 @@
+#ifndef WINDOW_FUNCTIONS_H
+#define WINDOW_FUNCTIONS_H
+
+#include "main.h"
+#include <cstdint>
+
+enum WindowKind {
+    WINDOW_SUM, WINDOW_MEAN, WINDOW_VARIANCE, WINDOW_MIN, WINDOW_MAX,
+    WINDOW_EWMA, WINDOW_LAG, WINDOW_DIFF, WINDOW_CUMSUM
+};
+
+// Looks up a window function by name (sum, mean, variance, min, max, ewma,
+// lag, diff, cumsum)
+bool find_window_function(const string& name, WindowKind& kind);
+
+// Evaluates kind over values (one per data row, NaN when missing) in row
+// order, in O(n) whatever the size. With groups (a dense id per row, e.g.
+// DictionaryColumn::ids) each group is its own series and the groups run in
+// parallel.
+//   sum, mean, variance, min, max: over the numbers among the last size rows
+//     of the series, NaN until size rows have been seen; running sums for the
+//     first three, monotonic deques for min and max
+//   ewma: exponentially weighted mean with span size, missing rows carry the
+//     previous value
+//   lag, diff: the value size rows back, and the change since then
+//   cumsum: running sum, NaN on missing rows
+vector<double> window_function(const vector<double>& values, const vector<uint32_t>* groups, size_t group_count,
+                               WindowKind kind, size_t size);
+
+// Extends result, the ungrouped window_function of the first result.size()
+// values, to all of values. Sliding functions, lag and diff recompute only
+// from size rows before the new ones, ewma continues from the last smoothed
+// value and cumsum from the running total, so appended rows cost O(new + size).
+void extend_window_function(const vector<double>& values, WindowKind kind, size_t size, vector<double>& result);
+
+#endif // WINDOW_FUNCTIONS_H